@@ -0,0 +1,106 @@
+#include "grammar.hpp"
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+
+#include "languages/c.hpp"
+#include "languages/java.hpp"
+#include "languages/xml.hpp"
+#include "languages/javascript.hpp"
+#include "languages/json.hpp"
+#include "languages/python.hpp"
+#include "languages/rust.hpp"
+#include "languages/toml.hpp"
+#include "languages/haskell.hpp"
+
+template <Backend backend> struct Languages {
+	static constexpr Language languages[] = {
+		language<c_file_type, c_language, backend>("C"),
+		language<java_file_type, java_language, backend>("Java"),
+		language<xml_file_type, xml_language, backend>("XML"),
+		language<javascript_file_type, javascript_language, backend>("JavaScript"),
+		language<json_file_type, json_language, backend>("JSON"),
+		language<python_file_type, python_language, backend>("Python"),
+		language<rust_file_type, rust_language, backend>("Rust"),
+		language<toml_file_type, toml_language, backend>("TOML"),
+		language<haskell_file_type, haskell_language, backend>("Haskell"),
+	};
+	static const Language* get(const char* name) {
+		for (const Language& language: languages) {
+			if (std::strcmp(language.name, name) == 0) {
+				return &language;
+			}
+		}
+		return nullptr;
+	}
+};
+
+static const char* get_file_name(const char* path) {
+	const char* file_name = path;
+	for (const char* i = path; *i != '\0'; ++i) {
+		if (*i == '/') {
+			file_name = i + 1;
+		}
+	}
+	return file_name;
+}
+
+static std::vector<char> read_file(const char* path) {
+	std::ifstream file(path);
+	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// the best of several cold highlights of the whole file
+static double measure(const Language* language, const Input* input, std::size_t size, int iterations, std::vector<Span>& spans) {
+	double best = 0.0;
+	for (int i = 0; i < iterations; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		Cache cache;
+		spans = prism::highlight(language, input, cache, 0, size);
+		const double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (i == 0 || time < best) {
+			best = time;
+		}
+	}
+	return best;
+}
+
+int main(int argc, const char** argv) {
+	if (argc <= 1) {
+		std::cerr << "Usage: " << argv[0] << " FILE [ITERATIONS]\n";
+		return 1;
+	}
+	const char* path = argv[1];
+	const Language* language = prism::get_language(get_file_name(path));
+	if (language == nullptr) {
+		std::cerr << "prism does currently not support this language\n";
+		return 1;
+	}
+	const int iterations = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 5;
+	const auto file = read_file(path);
+	StringInput input(file.data(), file.size());
+	std::vector<Span> template_spans;
+	std::vector<Span> bytecode_spans;
+	std::vector<Span> registered_spans;
+	const double template_time = measure(Languages<Backend::TEMPLATE>::get(language->name), &input, file.size(), iterations, template_spans);
+	const double bytecode_time = measure(Languages<Backend::BYTECODE>::get(language->name), &input, file.size(), iterations, bytecode_spans);
+	// the registered language can be hand-written, e.g. JSON
+	const double registered_time = measure(language, &input, file.size(), iterations, registered_spans);
+	const double megabytes = file.size() / 1000000.0;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "template " << std::setw(10) << template_time << " ms " << std::setw(8) << megabytes / (template_time / 1000.0) << " MB/s\n";
+	std::cout << "bytecode " << std::setw(10) << bytecode_time << " ms " << std::setw(8) << megabytes / (bytecode_time / 1000.0) << " MB/s\n";
+	std::cout << "registered " << std::setw(8) << registered_time << " ms " << std::setw(8) << megabytes / (registered_time / 1000.0) << " MB/s\n";
+	std::cout << "ratio    " << std::setw(10) << bytecode_time / template_time << '\n';
+	if (template_spans != bytecode_spans) {
+		std::cerr << "the backends produced different spans\n";
+		return 1;
+	}
+	if (registered_spans != template_spans) {
+		std::cerr << "the registered language produced different spans\n";
+		return 1;
+	}
+}
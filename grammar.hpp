@@ -0,0 +1,1222 @@
+#pragma once
+
+#include "prism.hpp"
+#include <cstdint>
+#include <atomic>
+#ifdef PRISM_PROFILE
+#include <map>
+#include <unordered_map>
+#endif
+
+class InputAdapter {
+	const Input* input;
+	Input::Chunk chunk;
+	std::size_t offset;
+	std::size_t i;
+	// everything from end on reads as the end of the input
+	std::size_t end;
+	void clamp_chunk() {
+		if (offset + chunk.size > end) {
+			chunk.size = end > offset ? end - offset : 0;
+		}
+	}
+public:
+	InputAdapter(const Input* input): input(input), chunk({nullptr, nullptr, 0}), offset(0), i(0), end(-1) {
+		set_position(0);
+	}
+	char get() const {
+		return i < chunk.size ? chunk.data[i] : '\0';
+	}
+	void advance() {
+		++i;
+		if (i == chunk.size) {
+			offset += chunk.size;
+			chunk = input->get_next_chunk(chunk.chunk);
+			clamp_chunk();
+			i = 0;
+		}
+	}
+	std::size_t get_position() const {
+		return offset + i;
+	}
+	// the bytes from the current position to the end of the current chunk
+	StringView get_chunk() const {
+		return StringView(chunk.data + i, chunk.size - i);
+	}
+	void set_position(std::size_t pos) {
+		if (pos >= offset && pos - offset < chunk.size) {
+			i = pos - offset;
+		}
+		else {
+			auto chunk_pair = input->get_chunk(pos);
+			chunk = chunk_pair.first;
+			offset = chunk_pair.second;
+			clamp_chunk();
+			i = pos - offset;
+		}
+	}
+	std::size_t get_end() const {
+		return end;
+	}
+	void set_end(std::size_t end) {
+		const std::size_t pos = get_position();
+		this->end = end;
+		chunk = {nullptr, nullptr, 0};
+		offset = 0;
+		i = 0;
+		set_position(pos);
+	}
+};
+
+class Spans {
+	// a std::vector<Span> or a std::pmr::vector<Span> that is only accessed through these functions,
+	// so that highlighting fills the vector of the caller directly
+	void* spans;
+	Span& (*get_last_span)(void* spans);
+	void (*add_span)(void* spans, const Span& span);
+	void (*resize)(void* spans, std::size_t size);
+	std::size_t size;
+	std::size_t start;
+	int style;
+	template <class V> static Span& get_last_span_of(void* spans) {
+		return static_cast<V*>(spans)->back();
+	}
+	template <class V> static void add_span_to(void* spans, const Span& span) {
+		static_cast<V*>(spans)->push_back(span);
+	}
+	template <class V> static void resize_spans(void* spans, std::size_t size) {
+		static_cast<V*>(spans)->resize(size);
+	}
+	void emit_span(std::size_t end, const Range& window) {
+		if (start == end) {
+			return;
+		}
+		if (end <= window.start || start >= window.end) {
+			return;
+		}
+		if (style == Style::DEFAULT) {
+			return;
+		}
+		if (size > 0) {
+			Span& last_span = get_last_span(spans);
+			if (last_span.end == start && last_span.style == style) {
+				last_span.end = std::min(end, window.end);
+				return;
+			}
+		}
+		add_span(spans, Span(std::max(start, window.start), std::min(end, window.end), style));
+		++size;
+	}
+public:
+	template <class V> Spans(V& spans): spans(&spans), get_last_span(get_last_span_of<V>), add_span(add_span_to<V>), resize(resize_spans<V>), size(spans.size()), start(0), style(Style::DEFAULT) {}
+	int change_style(std::size_t pos, int new_style, const Range& window) {
+		emit_span(pos, window);
+		start = pos;
+		const int old_style = style;
+		style = new_style;
+		return old_style;
+	}
+	struct SavePoint {
+		std::size_t spans_size;
+		std::size_t start;
+		int style;
+	};
+	SavePoint save() const {
+		return {size, start, style};
+	}
+	void restore(const SavePoint& save_point) {
+		if (size != save_point.spans_size) {
+			resize(spans, save_point.spans_size);
+			size = save_point.spans_size;
+		}
+		start = save_point.start;
+		style = save_point.style;
+	}
+};
+
+class Scope {
+	Scope* parent_scope;
+	std::size_t pos;
+	std::size_t max_pos;
+	Cache::Node* node;
+	std::size_t get_last_checkpoint() const {
+		return node ? node->get_last_checkpoint() : pos;
+	}
+	Cache::Node* find_child(std::size_t pos) const {
+		return node ? node->find_child(pos) : nullptr;
+	}
+	Cache::Node* ensure_node() {
+		if (node == nullptr) {
+			node = parent_scope->ensure_node()->add_child(pos, max_pos);
+		}
+		return node;
+	}
+public:
+	Scope(Cache::Node* node): parent_scope(nullptr), pos(0), max_pos(0), node(node) {}
+	Scope(Scope* parent_scope, std::size_t pos, std::size_t max_pos): parent_scope(parent_scope), pos(pos), max_pos(max_pos), node(parent_scope->find_child(pos)) {}
+	Cache::Node* get_node() {
+		return ensure_node();
+	}
+	Scope* get_parent_scope() const {
+		return parent_scope;
+	}
+	// checkpoints are at least 16 bytes apart
+	std::size_t get_next_checkpoint() const {
+		return get_last_checkpoint() + 16;
+	}
+	void add_checkpoint(std::size_t pos, std::size_t max_pos) {
+		if (pos >= get_next_checkpoint()) {
+			ensure_node()->add_checkpoint(pos, max_pos);
+		}
+	}
+	Cache::Checkpoint find_checkpoint(std::size_t pos) {
+		if (node) {
+			const Cache::Checkpoint* checkpoint = node->find_checkpoint(pos);
+			if (checkpoint) {
+				return *checkpoint;
+			}
+		}
+		return {this->pos, this->max_pos};
+	}
+};
+
+enum class Result: unsigned char {
+	FAILURE,
+	SUCCESS,
+	PARTIAL_SUCCESS
+};
+
+#ifdef PRISM_PROFILE
+// collects statistics for rules tagged with named()
+// the total time of recursive rules includes their nested invocations
+class Profiler {
+	std::unordered_map<const char*, RuleProfile> rules;
+	std::size_t backtracked_bytes;
+	std::chrono::nanoseconds children_time;
+public:
+	Profiler(): backtracked_bytes(0), children_time(0) {}
+	template <class F> Result profile(const char* name, F f) {
+		const auto start_time = std::chrono::steady_clock::now();
+		const std::size_t start_backtracked_bytes = backtracked_bytes;
+		const std::chrono::nanoseconds parent_children_time = children_time;
+		children_time = std::chrono::nanoseconds(0);
+		const Result result = f();
+		const std::chrono::nanoseconds time = std::chrono::steady_clock::now() - start_time;
+		RuleProfile& rule = rules[name];
+		rule.name = name;
+		++rule.invocations;
+		if (result != Result::FAILURE) {
+			++rule.successes;
+		}
+		rule.backtracked_bytes += backtracked_bytes - start_backtracked_bytes;
+		rule.total_time += time;
+		rule.self_time += time - children_time;
+		children_time = parent_children_time + time;
+		return result;
+	}
+	void backtrack(std::size_t bytes) {
+		backtracked_bytes += bytes;
+	}
+	std::vector<RuleProfile> get_profile() const {
+		// the same name can occur at different addresses
+		std::map<StringView, RuleProfile> merged_rules;
+		for (const auto& entry: rules) {
+			const RuleProfile& rule = entry.second;
+			auto iter = merged_rules.find(rule.name);
+			if (iter == merged_rules.end()) {
+				merged_rules.emplace(rule.name, rule);
+				continue;
+			}
+			iter->second.invocations += rule.invocations;
+			iter->second.successes += rule.successes;
+			iter->second.backtracked_bytes += rule.backtracked_bytes;
+			iter->second.total_time += rule.total_time;
+			iter->second.self_time += rule.self_time;
+		}
+		std::vector<RuleProfile> result;
+		for (const auto& entry: merged_rules) {
+			result.push_back(entry.second);
+		}
+		return result;
+	}
+	void reset() {
+		rules.clear();
+		backtracked_bytes = 0;
+		children_time = std::chrono::nanoseconds(0);
+	}
+};
+
+extern thread_local Profiler profiler;
+#endif
+
+template <bool emits_spans> struct SavePoint {
+	std::size_t pos;
+	Spans::SavePoint spans;
+};
+template <> struct SavePoint<false> {
+	std::size_t pos;
+};
+
+class ParseContext {
+	InputAdapter input;
+	Range window;
+	std::size_t max_pos;
+	Spans spans;
+	Scope* current_scope;
+	// the outermost repetition is the child scope of root_scope, it continues with the tail of the cache once it reaches tail_pos
+	Cache* cache;
+	Scope* root_scope;
+	Scope* tail_scope;
+	std::size_t tail_pos;
+	// add_checkpoint only looks at the interrupt and the budget every POLL_INTERVAL bytes, once the position reaches stop_pos
+	static constexpr std::size_t POLL_INTERVAL = 1024;
+	std::size_t stop_pos;
+	std::size_t poll_pos;
+	const std::atomic<bool>* interrupt;
+	std::chrono::steady_clock::time_point deadline;
+	std::size_t remaining_bytes;
+	bool limited;
+	bool stopped;
+	void update_stop_pos(std::size_t pos) {
+		poll_pos = pos;
+		stop_pos = limited ? std::min(window.end, pos + POLL_INTERVAL) : window.end;
+	}
+	bool poll(std::size_t pos) {
+		if (pos >= window.end) {
+			return true;
+		}
+		if (pos > poll_pos) {
+			remaining_bytes -= std::min(remaining_bytes, pos - poll_pos);
+		}
+		if ((interrupt && interrupt->load(std::memory_order_relaxed)) || remaining_bytes == 0 || std::chrono::steady_clock::now() >= deadline) {
+			stopped = true;
+			return true;
+		}
+		update_stop_pos(pos);
+		return false;
+	}
+	void resume_tail(std::size_t pos) {
+		// a parse that looked at an end set with set_end can take another path than the parse the tail comes from
+		if (is_end_reached()) {
+			return;
+		}
+		if (cache->resume_tail(tail_scope->get_node(), pos, std::max(max_pos, pos))) {
+			tail_scope = nullptr;
+			if (window.start > pos) {
+				skip_to_checkpoint();
+			}
+			return;
+		}
+		tail_pos = cache->get_tail_pos();
+	}
+public:
+	// the spans are added to a std::vector<Span> or a std::pmr::vector<Span>
+	template <class V> ParseContext(const Input* input, V& spans, std::size_t window_start, std::size_t window_end): input(input), window(window_start, window_end), max_pos(0), spans(spans), current_scope(nullptr), cache(nullptr), root_scope(nullptr), tail_scope(nullptr), tail_pos(-1), stop_pos(window_end), poll_pos(0), interrupt(nullptr), deadline(std::chrono::steady_clock::time_point::max()), remaining_bytes(-1), limited(false), stopped(false) {}
+	// parsing stops at the next checkpoint once the interrupt is set
+	void set_interrupt(const std::atomic<bool>* interrupt) {
+		this->interrupt = interrupt;
+		limited = true;
+		update_stop_pos(input.get_position());
+	}
+	void set_budget(const Budget& budget) {
+		if (budget.time != std::chrono::steady_clock::duration::max()) {
+			deadline = std::chrono::steady_clock::now() + budget.time;
+		}
+		remaining_bytes = budget.bytes;
+		limited = true;
+		update_stop_pos(input.get_position());
+	}
+	// everything from end on reads as the end of the input
+	void set_end(std::size_t end) {
+		if (end < input.get_end()) {
+			input.set_end(end);
+		}
+	}
+	// whether parsing looked at the end that was set with set_end
+	bool is_end_reached() const {
+		return std::max(max_pos, input.get_position()) >= input.get_end();
+	}
+	// whether parsing stopped before the end of the window because of the interrupt or the budget
+	bool is_stopped() const {
+		return stopped;
+	}
+	char get() const {
+		return input.get();
+	}
+	void advance() {
+		input.advance();
+	}
+	void advance(std::size_t n) {
+		input.set_position(input.get_position() + n);
+	}
+	std::size_t get_position() const {
+		return input.get_position();
+	}
+	// lets hand-written parse functions scan several bytes at once
+	StringView get_chunk() const {
+		return input.get_chunk();
+	}
+	void set_position(std::size_t pos) {
+		input.set_position(pos);
+	}
+	int change_style(int new_style) {
+		return spans.change_style(input.get_position(), new_style, window);
+	}
+	// add_checkpoint neither adds a checkpoint nor stops before this position,
+	// so a repetition of single bytes can advance to it at once
+	std::size_t get_next_checkpoint() const {
+		const std::size_t next = std::min(stop_pos, current_scope->get_next_checkpoint());
+		return current_scope == tail_scope ? std::min(next, tail_pos) : next;
+	}
+	bool add_checkpoint() {
+		std::size_t pos = input.get_position();
+		if (current_scope == tail_scope && pos >= tail_pos) {
+			resume_tail(pos);
+			pos = input.get_position();
+		}
+		current_scope->add_checkpoint(pos, std::max(max_pos, pos));
+		return pos >= stop_pos && poll(pos);
+	}
+	void skip_to_checkpoint() {
+		const auto checkpoint = current_scope->find_checkpoint(window.start);
+		if (limited && checkpoint.pos > input.get_position()) {
+			// skipped bytes do not count against the budget
+			poll_pos += checkpoint.pos - input.get_position();
+			stop_pos = std::min(window.end, poll_pos + POLL_INTERVAL);
+		}
+		input.set_position(checkpoint.pos);
+		max_pos = checkpoint.max_pos;
+	}
+	template <class F> void add_root_scope(Cache& cache, F f) {
+		Scope scope(cache.get_root_node());
+		current_scope = &scope;
+		if (cache.get_tail_pos() != static_cast<std::size_t>(-1)) {
+			this->cache = &cache;
+			root_scope = &scope;
+		}
+		f();
+		current_scope = nullptr;
+		root_scope = nullptr;
+	}
+	template <class F> Result add_scope(F f) {
+		Scope scope(current_scope, input.get_position(), std::max(max_pos, input.get_position()));
+		if (current_scope == root_scope) {
+			tail_scope = &scope;
+			tail_pos = cache->get_tail_pos();
+		}
+		current_scope = &scope;
+		const Result result = f();
+		current_scope = scope.get_parent_scope();
+		if (tail_scope == &scope) {
+			tail_scope = nullptr;
+		}
+		return result;
+	}
+	// parses the region up to the end delimiter with the given language in its own cache node
+	template <bool can_checkpoint> Result add_embedded_scope(const char* end, void (*parse)(ParseContext&));
+	// subexpressions that can not emit spans only need to save and restore the position
+	template <bool emits_spans = true> SavePoint<emits_spans> save() const {
+		if constexpr (emits_spans) {
+			return {input.get_position(), spans.save()};
+		}
+		else {
+			return {input.get_position()};
+		}
+	}
+	template <bool emits_spans> void restore(const SavePoint<emits_spans>& save_point) {
+		max_pos = std::max(max_pos, input.get_position());
+#ifdef PRISM_PROFILE
+		profiler.backtrack(input.get_position() - save_point.pos);
+#endif
+		input.set_position(save_point.pos);
+		if constexpr (emits_spans) {
+			spans.restore(save_point.spans);
+		}
+	}
+};
+
+// a grammar compiled at compile time into compact instruction tables that are executed by a single interpreter
+// instead of instantiating parse functions for every expression
+class Program {
+public:
+	enum class Opcode: unsigned char {
+		CHAR,
+		STRING,
+		SEQUENCE,
+		CHOICE,
+		REPETITION,
+		AND,
+		NOT,
+		HIGHLIGHT,
+		CALL,
+		EMBED,
+		UNICODE_CHAR
+	};
+	struct Instruction {
+		Opcode opcode;
+		bool can_checkpoint = false;
+		bool emits_spans = false;
+		// repetitions whose minimum repetitions use a child compiled without checkpoints
+		bool has_minimum_child = false;
+		// the number of instructions of this expression including its children
+		std::uint32_t size = 0;
+		std::uint32_t a = 0;
+		std::uint32_t b = 0;
+	};
+	class Builder {
+		static constexpr std::size_t MAX_INSTRUCTIONS = 4096;
+		static constexpr std::size_t MAX_CHAR_CLASSES = 256;
+		static constexpr std::size_t MAX_STRINGS = 512;
+		static constexpr std::size_t MAX_SUBROUTINES = 64;
+		static constexpr std::size_t MAX_GUESTS = 16;
+		struct Subroutine {
+			const void* expression;
+			bool can_checkpoint;
+			void (*compile)(Builder&);
+		};
+		Subroutine subroutines[MAX_SUBROUTINES];
+	public:
+		Instruction instructions[MAX_INSTRUCTIONS];
+		std::uint64_t char_classes[MAX_CHAR_CLASSES * 4];
+		const char* strings[MAX_STRINGS];
+		std::uint32_t subroutine_addresses[MAX_SUBROUTINES];
+		// the parse functions of embedded languages
+		void (*guests[MAX_GUESTS])(ParseContext&);
+		std::size_t instructions_size;
+		std::size_t char_classes_size;
+		std::size_t strings_size;
+		std::size_t subroutines_size;
+		std::size_t guests_size;
+		constexpr Builder(): subroutines{}, instructions{}, char_classes{}, strings{}, subroutine_addresses{}, guests{}, instructions_size(0), char_classes_size(0), strings_size(0), subroutines_size(0), guests_size(0) {}
+		template <class T> static constexpr Builder compile(const T& expression) {
+			Builder builder;
+			expression.template compile<true>(builder);
+			// subroutines can add further subroutines while they are compiled
+			for (std::size_t i = 0; i < builder.subroutines_size; ++i) {
+				builder.subroutine_addresses[i] = builder.instructions_size;
+				builder.subroutines[i].compile(builder);
+			}
+			return builder;
+		}
+		constexpr std::uint32_t begin(const Instruction& instruction) {
+			instructions[instructions_size] = instruction;
+			return instructions_size++;
+		}
+		constexpr void end(std::uint32_t index) {
+			instructions[index].size = instructions_size - index;
+		}
+		template <class F> constexpr std::uint32_t add_char_class(F f) {
+			std::uint64_t char_class[4] = {0, 0, 0, 0};
+			for (int i = 0; i < 256; ++i) {
+				if (f(static_cast<char>(i))) {
+					char_class[i / 64] |= std::uint64_t(1) << (i % 64);
+				}
+			}
+			for (std::size_t i = 0; i < char_classes_size; ++i) {
+				const std::uint64_t* existing = char_classes + i * 4;
+				if (existing[0] == char_class[0] && existing[1] == char_class[1] && existing[2] == char_class[2] && existing[3] == char_class[3]) {
+					return i;
+				}
+			}
+			for (std::size_t i = 0; i < 4; ++i) {
+				char_classes[char_classes_size * 4 + i] = char_class[i];
+			}
+			return char_classes_size++;
+		}
+		constexpr std::uint32_t add_string(const char* string) {
+			strings[strings_size] = string;
+			return strings_size++;
+		}
+		constexpr std::uint32_t add_guest(void (*parse)(ParseContext&)) {
+			for (std::size_t i = 0; i < guests_size; ++i) {
+				if (guests[i] == parse) {
+					return i;
+				}
+			}
+			guests[guests_size] = parse;
+			return guests_size++;
+		}
+		template <bool can_checkpoint, class T> constexpr std::uint32_t add_subroutine() {
+			for (std::size_t i = 0; i < subroutines_size; ++i) {
+				if (subroutines[i].expression == &T::expression && subroutines[i].can_checkpoint == can_checkpoint) {
+					return i;
+				}
+			}
+			subroutines[subroutines_size] = {&T::expression, can_checkpoint, [](Builder& builder) {
+				T::expression.template compile<can_checkpoint>(builder);
+			}};
+			return subroutines_size++;
+		}
+	};
+	// the used part of a builder
+	template <std::size_t INSTRUCTIONS, std::size_t CHAR_CLASSES, std::size_t STRINGS, std::size_t SUBROUTINES, std::size_t GUESTS> struct Tables {
+		Instruction instructions[INSTRUCTIONS];
+		std::uint64_t char_classes[CHAR_CLASSES * 4 + 1];
+		const char* strings[STRINGS + 1];
+		std::uint32_t subroutine_addresses[SUBROUTINES + 1];
+		void (*guests[GUESTS + 1])(ParseContext&);
+		constexpr Tables(const Builder& builder): instructions{}, char_classes{}, strings{}, subroutine_addresses{}, guests{} {
+			for (std::size_t i = 0; i < INSTRUCTIONS; ++i) {
+				instructions[i] = builder.instructions[i];
+			}
+			for (std::size_t i = 0; i < CHAR_CLASSES * 4; ++i) {
+				char_classes[i] = builder.char_classes[i];
+			}
+			for (std::size_t i = 0; i < STRINGS; ++i) {
+				strings[i] = builder.strings[i];
+			}
+			for (std::size_t i = 0; i < SUBROUTINES; ++i) {
+				subroutine_addresses[i] = builder.subroutine_addresses[i];
+			}
+			for (std::size_t i = 0; i < GUESTS; ++i) {
+				guests[i] = builder.guests[i];
+			}
+		}
+	};
+private:
+	const Instruction* instructions;
+	const std::uint64_t* char_classes;
+	const char* const* strings;
+	const std::uint32_t* subroutine_addresses;
+	void (* const* guests)(ParseContext&);
+	bool test_char_class(std::uint32_t char_class, char c) const {
+		const unsigned char i = c;
+		return (char_classes[char_class * 4 + i / 64] >> (i % 64)) & 1;
+	}
+	template <bool emits_spans> Result execute_sequence(std::uint32_t ip, ParseContext& context) const;
+	template <bool emits_spans> Result execute_minimum_repetitions(std::uint32_t ip, std::uint32_t child, ParseContext& context) const;
+	template <bool emits_spans> Result execute_lookahead(std::uint32_t ip, ParseContext& context) const;
+	template <bool can_checkpoint> Result execute_repetitions(std::uint32_t ip, std::uint32_t child, ParseContext& context) const;
+	Result execute(std::uint32_t ip, ParseContext& context) const;
+public:
+	template <std::size_t INSTRUCTIONS, std::size_t CHAR_CLASSES, std::size_t STRINGS, std::size_t SUBROUTINES, std::size_t GUESTS> constexpr Program(const Tables<INSTRUCTIONS, CHAR_CLASSES, STRINGS, SUBROUTINES, GUESTS>& tables): instructions(tables.instructions), char_classes(tables.char_classes), strings(tables.strings), subroutine_addresses(tables.subroutine_addresses), guests(tables.guests) {}
+	Result execute(ParseContext& context) const {
+		return execute(0, context);
+	}
+};
+
+template <class parse> struct Bytecode;
+
+template <class F> class Char {
+	F f;
+public:
+	static constexpr bool always_succeeds() {
+		return false;
+	}
+	static constexpr bool emits_spans() {
+		return false;
+	}
+	constexpr Char(F f): f(f) {}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		program.end(program.begin({Program::Opcode::CHAR, false, false, false, 0, program.add_char_class(f)}));
+	}
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+		if (!f(context.get())) {
+			return Result::FAILURE;
+		}
+		context.advance();
+		return Result::SUCCESS;
+	}
+};
+
+enum class UnicodeProperty {
+	XID_START,
+	XID_CONTINUE
+};
+// consumes a UTF-8 encoded code point with the property, invalid and overlong sequences never match
+Result parse_code_point(ParseContext& context, UnicodeProperty property);
+
+// an ASCII character class that also matches the non-ASCII code points with a Unicode property
+// ASCII characters are looked up in a bitmap without decoding
+template <UnicodeProperty property> class UnicodeChar {
+	// the bits of the non-ASCII bytes stay zero so that the lookup needs no range check
+	std::uint64_t ascii[4];
+public:
+	static constexpr bool always_succeeds() {
+		return false;
+	}
+	static constexpr bool emits_spans() {
+		return false;
+	}
+	template <class F> constexpr UnicodeChar(F f): ascii{0, 0, 0, 0} {
+		for (int i = 0; i < 128; ++i) {
+			if (f(static_cast<char>(i))) {
+				ascii[i / 64] |= std::uint64_t(1) << (i % 64);
+			}
+		}
+	}
+	constexpr bool test_ascii(char c) const {
+		const unsigned char i = c;
+		return (ascii[i / 64] >> (i % 64)) & 1;
+	}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		program.end(program.begin({Program::Opcode::UNICODE_CHAR, false, false, false, 0, program.add_char_class([this](char c) {
+			return test_ascii(c);
+		}), static_cast<std::uint32_t>(property)}));
+	}
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+		const char c = context.get();
+		if (test_ascii(c)) {
+			context.advance();
+			return Result::SUCCESS;
+		}
+		if (static_cast<unsigned char>(c) < 128) {
+			return Result::FAILURE;
+		}
+		return parse_code_point(context, property);
+	}
+};
+
+class String {
+	const char* string;
+public:
+	static constexpr bool always_succeeds() {
+		return false;
+	}
+	static constexpr bool emits_spans() {
+		return false;
+	}
+	constexpr String(const char* string): string(string) {}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		program.end(program.begin({Program::Opcode::STRING, false, false, false, 0, program.add_string(string)}));
+	}
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+		if (*string == '\0') {
+			return Result::SUCCESS;
+		}
+		if (context.get() != *string) {
+			return Result::FAILURE;
+		}
+		const auto save_point = context.save<false>();
+		context.advance();
+		for (const char* s = string + 1; *s != '\0'; ++s) {
+			if (context.get() != *s) {
+				context.restore(save_point);
+				return Result::FAILURE;
+			}
+			context.advance();
+		}
+		return Result::SUCCESS;
+	}
+};
+
+template <class... T> class Sequence;
+template <> class Sequence<> {
+public:
+	static constexpr bool always_succeeds() {
+		return true;
+	}
+	static constexpr bool emits_spans() {
+		return false;
+	}
+	constexpr Sequence() {}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		program.end(program.begin({Program::Opcode::SEQUENCE, can_checkpoint, emits_spans()}));
+	}
+	template <bool can_checkpoint> constexpr void compile_children(Program::Builder&) const {}
+	template <bool can_checkpoint> Result parse(ParseContext&) const {
+		return Result::SUCCESS;
+	}
+};
+template <class T0, class... T> class Sequence<T0, T...> {
+	T0 t0;
+	Sequence<T...> t;
+public:
+	static constexpr bool always_succeeds() {
+		return T0::always_succeeds() && Sequence<T...>::always_succeeds();
+	}
+	static constexpr bool emits_spans() {
+		return T0::emits_spans() || Sequence<T...>::emits_spans();
+	}
+	constexpr Sequence(T0 t0, T... t): t0(t0), t(t...) {}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		const std::uint32_t index = program.begin({Program::Opcode::SEQUENCE, can_checkpoint, emits_spans()});
+		compile_children<can_checkpoint>(program);
+		program.end(index);
+	}
+	template <bool can_checkpoint> constexpr void compile_children(Program::Builder& program) const {
+		t0.template compile<can_checkpoint && Sequence<T...>::always_succeeds()>(program);
+		t.template compile_children<can_checkpoint>(program);
+	}
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+		const auto save_point = context.save<emits_spans()>();
+		const Result result = t0.template parse<can_checkpoint && Sequence<T...>::always_succeeds()>(context);
+		if (result != Result::SUCCESS) {
+			return result;
+		}
+		{
+			const Result result = t.template parse<can_checkpoint>(context);
+			if (result == Result::FAILURE) {
+				context.restore(save_point);
+			}
+			return result;
+		}
+	}
+};
+
+template <class... T> class Choice;
+template <> class Choice<> {
+public:
+	static constexpr bool always_succeeds() {
+		return false;
+	}
+	static constexpr bool emits_spans() {
+		return false;
+	}
+	constexpr Choice() {}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		program.end(program.begin({Program::Opcode::CHOICE, can_checkpoint, emits_spans()}));
+	}
+	template <bool can_checkpoint> constexpr void compile_children(Program::Builder&) const {}
+	template <bool can_checkpoint> Result parse(ParseContext&) const {
+		return Result::FAILURE;
+	}
+};
+template <class T0, class... T> class Choice<T0, T...> {
+	T0 t0;
+	Choice<T...> t;
+public:
+	static constexpr bool always_succeeds() {
+		return T0::always_succeeds() || Choice<T...>::always_succeeds();
+	}
+	static constexpr bool emits_spans() {
+		return T0::emits_spans() || Choice<T...>::emits_spans();
+	}
+	constexpr Choice(T0 t0, T... t): t0(t0), t(t...) {}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		const std::uint32_t index = program.begin({Program::Opcode::CHOICE, can_checkpoint, emits_spans()});
+		compile_children<can_checkpoint>(program);
+		program.end(index);
+	}
+	template <bool can_checkpoint> constexpr void compile_children(Program::Builder& program) const {
+		t0.template compile<can_checkpoint>(program);
+		t.template compile_children<can_checkpoint>(program);
+	}
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+		const Result result = t0.template parse<can_checkpoint>(context);
+		if (result != Result::FAILURE) {
+			return result;
+		}
+		return t.template parse<can_checkpoint>(context);
+	}
+};
+
+template <std::size_t MIN_REPETITIONS, std::size_t MAX_REPETITIONS, class T> class Repetition {
+	T t;
+public:
+	static constexpr bool always_succeeds() {
+		return MIN_REPETITIONS == 0 || T::always_succeeds();
+	}
+	static constexpr bool emits_spans() {
+		return T::emits_spans();
+	}
+	constexpr Repetition(T t): t(t) {}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		static_assert(MAX_REPETITIONS != 0 || !T::always_succeeds(), "infinite loop in grammar");
+		constexpr bool has_minimum_child = MIN_REPETITIONS > 1 && can_checkpoint && !T::always_succeeds();
+		const std::uint32_t index = program.begin({Program::Opcode::REPETITION, can_checkpoint, T::emits_spans(), has_minimum_child, 0, MIN_REPETITIONS, MAX_REPETITIONS});
+		t.template compile<can_checkpoint>(program);
+		if constexpr (has_minimum_child) {
+			t.template compile<false>(program);
+		}
+		program.end(index);
+	}
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+		if constexpr (MIN_REPETITIONS == 1) {
+			const Result result = t.template parse<can_checkpoint>(context);
+			if (result != Result::SUCCESS) {
+				return result;
+			}
+		}
+		else if constexpr (MIN_REPETITIONS > 1) {
+			const auto save_point = context.save<T::emits_spans()>();
+			for (std::size_t i = 0; i < MIN_REPETITIONS; ++i) {
+				const Result result = t.template parse<can_checkpoint && T::always_succeeds()>(context);
+				if (result != Result::SUCCESS) {
+					if (result == Result::FAILURE) {
+						context.restore(save_point);
+					}
+					return result;
+				}
+			}
+		}
+		static_assert(MAX_REPETITIONS != 0 || !T::always_succeeds(), "infinite loop in grammar");
+		if constexpr (can_checkpoint && MAX_REPETITIONS != 1) {
+			return context.add_scope([&]() {
+				context.skip_to_checkpoint();
+				for (std::size_t i = MIN_REPETITIONS; (MAX_REPETITIONS == 0 || i < MAX_REPETITIONS); ++i) {
+					const Result result = t.template parse<can_checkpoint>(context);
+					if (result != Result::SUCCESS) {
+						return result == Result::FAILURE ? Result::SUCCESS : result;
+					}
+					if (context.add_checkpoint()) {
+						return Result::PARTIAL_SUCCESS;
+					}
+				}
+				return Result::SUCCESS;
+			});
+		}
+		else {
+			for (std::size_t i = MIN_REPETITIONS; MAX_REPETITIONS == 0 || i < MAX_REPETITIONS; ++i) {
+				const Result result = t.template parse<can_checkpoint>(context);
+				if (result != Result::SUCCESS) {
+					return result == Result::FAILURE ? Result::SUCCESS : result;
+				}
+			}
+			return Result::SUCCESS;
+		}
+	}
+};
+
+template <class T> class And {
+	T t;
+public:
+	static constexpr bool always_succeeds() {
+		return T::always_succeeds();
+	}
+	static constexpr bool emits_spans() {
+		return false;
+	}
+	constexpr And(T t): t(t) {}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		const std::uint32_t index = program.begin({Program::Opcode::AND, false, T::emits_spans()});
+		t.template compile<false>(program);
+		program.end(index);
+	}
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+		const auto save_point = context.save<T::emits_spans()>();
+		if (t.template parse<false>(context) == Result::SUCCESS) {
+			context.restore(save_point);
+			return Result::SUCCESS;
+		}
+		else {
+			return Result::FAILURE;
+		}
+	}
+};
+
+template <class T> class Not {
+	T t;
+public:
+	static constexpr bool always_succeeds() {
+		return false;
+	}
+	static constexpr bool emits_spans() {
+		return false;
+	}
+	constexpr Not(T t): t(t) {}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		const std::uint32_t index = program.begin({Program::Opcode::NOT, false, T::emits_spans()});
+		t.template compile<false>(program);
+		program.end(index);
+	}
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+		const auto save_point = context.save<T::emits_spans()>();
+		if (t.template parse<false>(context) == Result::SUCCESS) {
+			context.restore(save_point);
+			return Result::FAILURE;
+		}
+		else {
+			return Result::SUCCESS;
+		}
+	}
+};
+
+template <class T> class Highlight {
+	T t;
+	int style;
+public:
+	static constexpr bool always_succeeds() {
+		return T::always_succeeds();
+	}
+	static constexpr bool emits_spans() {
+		return true;
+	}
+	constexpr Highlight(T t, int style): t(t), style(style) {}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		const std::uint32_t index = program.begin({Program::Opcode::HIGHLIGHT, can_checkpoint, true, false, 0, static_cast<std::uint32_t>(style)});
+		t.template compile<can_checkpoint>(program);
+		program.end(index);
+	}
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+		const int old_style = context.change_style(style);
+		const Result result = t.template parse<can_checkpoint>(context);
+		context.change_style(old_style);
+		return result;
+	}
+};
+
+template <class T> class Named {
+	T t;
+	const char* name;
+public:
+	static constexpr bool always_succeeds() {
+		return T::always_succeeds();
+	}
+	static constexpr bool emits_spans() {
+		return T::emits_spans();
+	}
+	constexpr Named(T t, const char* name): t(t), name(name) {}
+	// the profiler only covers the template backend
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		t.template compile<can_checkpoint>(program);
+	}
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+#ifdef PRISM_PROFILE
+		return profiler.profile(name, [&]() {
+			return t.template parse<can_checkpoint>(context);
+		});
+#else
+		return t.template parse<can_checkpoint>(context);
+#endif
+	}
+};
+
+template <class T> class Reference {
+public:
+	static constexpr bool always_succeeds() {
+		return decltype(T::expression)::always_succeeds();
+	}
+	// references can be recursive, so they are conservatively assumed to emit spans
+	static constexpr bool emits_spans() {
+		return true;
+	}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		program.end(program.begin({Program::Opcode::CALL, can_checkpoint, true, false, 0, program.template add_subroutine<can_checkpoint, T>()}));
+	}
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+		return T::expression.template parse<can_checkpoint>(context);
+	}
+};
+
+constexpr auto get_expression(char c) {
+	return Char([c](char i) {
+		return i == c;
+	});
+}
+constexpr String get_expression(const char* s) {
+	return String(s);
+}
+constexpr auto get_expression(bool (*f)(char)) {
+	return Char(f);
+}
+template <class T> constexpr T get_expression(T expression) {
+	return expression;
+}
+
+constexpr auto range(char first, char last) {
+	return Char([first, last](char c) {
+		return c >= first && c <= last;
+	});
+}
+// f decides about ASCII characters, other code points match if they have the property
+template <UnicodeProperty property, class F> constexpr auto unicode_char(F f) {
+	return UnicodeChar<property>(f);
+}
+constexpr auto any_char() {
+	return Char([](char c) {
+		return c != '\0';
+	});
+}
+template <class... T> constexpr Sequence<T...> sequence_(T... t) {
+	return Sequence<T...>(t...);
+}
+template <class... T> constexpr auto sequence(T... t) {
+	return sequence_(get_expression(t)...);
+}
+template <class... T> constexpr Choice<T...> choice_(T... t) {
+	return Choice<T...>(t...);
+}
+template <class... T> constexpr auto choice(T... t) {
+	return choice_(get_expression(t)...);
+}
+template <std::size_t MIN_REPETITIONS, std::size_t MAX_REPETITIONS, class T> constexpr Repetition<MIN_REPETITIONS, MAX_REPETITIONS, T> repetition_(T t) {
+	return Repetition<MIN_REPETITIONS, MAX_REPETITIONS, T>(t);
+}
+template <std::size_t MIN_REPETITIONS = 0, std::size_t MAX_REPETITIONS = 0, class T> constexpr auto repetition(T t) {
+	return repetition_<MIN_REPETITIONS, MAX_REPETITIONS>(get_expression(t));
+}
+template <class T> constexpr auto zero_or_more(T t) {
+	return repetition<0>(t);
+}
+template <class T> constexpr auto one_or_more(T t) {
+	return repetition<1>(t);
+}
+template <class T> constexpr auto optional(T t) {
+	return repetition<0, 1>(t);
+}
+template <class T> constexpr auto and_(T t) {
+	return And(get_expression(t));
+}
+template <class T> constexpr auto not_(T t) {
+	return Not(get_expression(t));
+}
+template <class T> constexpr auto highlight(int style, T t) {
+	return Highlight(get_expression(t), style);
+}
+template <class T> constexpr auto named(const char* name, T t) {
+	return Named(get_expression(t), name);
+}
+template <class T> constexpr auto any_char_but(T t) {
+	return sequence(not_(t), any_char());
+}
+constexpr auto end() {
+	return not_(any_char());
+}
+template <class T> constexpr auto ends_with(T t) {
+	const auto e = sequence(t, end());
+	return sequence(repetition(any_char_but(e)), e);
+}
+template <class T> constexpr auto reference() {
+	return Reference<T>();
+}
+
+template <class... T> constexpr auto scope(T... t) {
+	return choice(t...);
+}
+template <class S, class E, class... T> constexpr auto nested_scope(int style, S start, E end, T... t) {
+	return highlight(style, sequence(
+		start,
+		repetition(sequence(not_(end), choice(t..., any_char()))),
+		optional(end)
+	));
+}
+template <class T> constexpr auto root_scope(T t) {
+	return repetition(choice(t, any_char()));
+}
+
+template <class T> constexpr auto shebang(T interpreter) {
+	const auto separator = choice('/', ' ');
+	return sequence("#!", repetition(any_char_but(choice('\n', sequence(separator, interpreter)))), separator, interpreter);
+}
+
+template <class parse> struct Bytecode {
+	static constexpr Program::Builder builder = Program::Builder::compile(root_scope(reference<parse>()));
+	static constexpr Program::Tables<builder.instructions_size, builder.char_classes_size, builder.strings_size, builder.subroutines_size, builder.guests_size> tables = builder;
+};
+
+struct FileType {
+	static constexpr const char* extensions = "";
+	static constexpr auto content = choice();
+};
+
+struct Language {
+	const char* name;
+	const char* file_extensions;
+	bool (*parse_content)(ParseContext&);
+	void (*parse)(ParseContext&);
+	// stored spans are only reused if the version matches, see language()
+	unsigned version;
+};
+
+enum class Backend {
+	TEMPLATE,
+	BYTECODE
+};
+
+// the backend of language(), CMake defines PRISM_BYTECODE for the languages that are selected with PRISM_BYTECODE_<LANGUAGE>
+#ifdef PRISM_BYTECODE
+#ifdef PRISM_PROFILE
+#error "the bytecode backend does not record named() rules, PRISM_PROFILE needs the template backend"
+#endif
+constexpr Backend default_backend = Backend::BYTECODE;
+#else
+constexpr Backend default_backend = Backend::TEMPLATE;
+#endif
+
+template <class parse, Backend backend> constexpr auto get_parse_function() {
+	if constexpr (backend == Backend::BYTECODE) {
+		return [](ParseContext& context) {
+			Program(Bytecode<parse>::tables).execute(context);
+		};
+	}
+	else {
+		return [](ParseContext& context) {
+			root_scope(reference<parse>()).template parse<true>(context);
+		};
+	}
+}
+
+// the version has to be increased whenever a change to the grammar or to a language it embeds changes the spans it produces,
+// tests/versions.cpp fails until it is
+template <class file_type, class parse, Backend backend = default_backend> constexpr Language language(const char* name, unsigned version = 1) {
+	return {
+		name,
+		file_type::extensions,
+		[](ParseContext& context) {
+			return file_type::content.template parse<false>(context) == Result::SUCCESS;
+		},
+		get_parse_function<parse, backend>(),
+		version
+	};
+}
+
+// the end of an embedded region is the first occurrence of its end delimiter
+inline std::size_t find_end_delimiter(ParseContext& context, const char* end) {
+	repetition(any_char_but(end)).template parse<false>(context);
+	return context.get_position();
+}
+
+template <bool can_checkpoint> Result ParseContext::add_embedded_scope(const char* end, void (*parse)(ParseContext&)) {
+	const std::size_t start_pos = input.get_position();
+	const std::size_t start_max_pos = std::max(max_pos, start_pos);
+	// the host only looks for the end delimiter, so the guest can not affect the parse after the region
+	const std::size_t end_pos = find_end_delimiter(*this, end);
+	const std::size_t host_max_pos = std::max(max_pos, end_pos);
+	Cache::Node temporary_node(start_pos, start_max_pos);
+	Scope scope = can_checkpoint ? Scope(current_scope, start_pos, start_max_pos) : Scope(&temporary_node);
+	if constexpr (can_checkpoint) {
+		Cache::Node* node = scope.get_node();
+		node->end_pos = end_pos;
+		node->end_delimiter = end;
+	}
+	Result result = Result::SUCCESS;
+	// the guest does not need to run if the region ends before the window
+	if (end_pos > window.start) {
+		Scope* parent_scope = current_scope;
+		const std::size_t input_end = input.get_end();
+		current_scope = &scope;
+		max_pos = start_max_pos;
+		input.set_position(start_pos);
+		input.set_end(end_pos);
+		parse(*this);
+		if (input.get_position() < end_pos) {
+			result = Result::PARTIAL_SUCCESS;
+		}
+		input.set_end(input_end);
+		current_scope = parent_scope;
+		if constexpr (can_checkpoint) {
+			// to the guest the input ends at end_pos, so what it saw there depends on the end delimiter like the host
+			scope.get_node()->raise_max_pos(end_pos, host_max_pos);
+		}
+	}
+	max_pos = std::max(max_pos, host_max_pos);
+	input.set_position(end_pos);
+	return result;
+}
+
+template <class T> class Embed {
+	const char* end;
+public:
+	static constexpr bool always_succeeds() {
+		return true;
+	}
+	static constexpr bool emits_spans() {
+		return true;
+	}
+	constexpr Embed(const char* end): end(end) {}
+	template <bool can_checkpoint> constexpr void compile(Program::Builder& program) const {
+		program.end(program.begin({Program::Opcode::EMBED, can_checkpoint, true, false, 0, program.add_string(end), program.add_guest(get_parse_function<T, Backend::BYTECODE>())}));
+	}
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+		return context.template add_embedded_scope<can_checkpoint>(end, get_parse_function<T, Backend::TEMPLATE>());
+	}
+};
+
+// the text after start up to the end delimiter is highlighted as the given language
+// the delimiter itself is left to the surrounding grammar
+template <class T, class S> constexpr auto embed(S start, const char* end) {
+	return sequence(start, Embed<T>(end));
+}
+
+constexpr auto hex_digit = choice(range('0', '9'), range('a', 'f'), range('A', 'F'));
@@ -0,0 +1,34 @@
+#include "prism.hpp"
+
+// registers the languages selected with the PRISM_LANGUAGE_* options before main
+// the languages are constant-initialized, so they can be registered during dynamic initialization
+static const bool registered = []() {
+#ifdef PRISM_LANGUAGE_C
+	prism::register_language(&prism::languages::c);
+#endif
+#ifdef PRISM_LANGUAGE_JAVA
+	prism::register_language(&prism::languages::java);
+#endif
+#ifdef PRISM_LANGUAGE_XML
+	prism::register_language(&prism::languages::xml);
+#endif
+#ifdef PRISM_LANGUAGE_JAVASCRIPT
+	prism::register_language(&prism::languages::javascript);
+#endif
+#ifdef PRISM_LANGUAGE_JSON
+	prism::register_language(&prism::languages::json);
+#endif
+#ifdef PRISM_LANGUAGE_PYTHON
+	prism::register_language(&prism::languages::python);
+#endif
+#ifdef PRISM_LANGUAGE_RUST
+	prism::register_language(&prism::languages::rust);
+#endif
+#ifdef PRISM_LANGUAGE_TOML
+	prism::register_language(&prism::languages::toml);
+#endif
+#ifdef PRISM_LANGUAGE_HASKELL
+	prism::register_language(&prism::languages::haskell);
+#endif
+	return true;
+}();
@@ -0,0 +1,3 @@
+#include "c.hpp"
+
+const Language prism::languages::c = language<c_file_type, c_language>("C");
@@ -1,7 +1,11 @@
+#pragma once
+
+#include "../grammar.hpp"
+
 constexpr auto c_whitespace_char = choice(' ', '\t', '\n', '\r', '\v', '\f');
 constexpr auto c_identifier_begin_char = choice(range('a', 'z'), range('A', 'Z'), '_');
 constexpr auto c_identifier_char = choice(range('a', 'z'), range('A', 'Z'), '_', range('0', '9'));
-constexpr auto c_identifier = sequence(c_identifier_begin_char, zero_or_more(c_identifier_char));
+constexpr auto c_identifier = named("c_identifier", sequence(c_identifier_begin_char, zero_or_more(c_identifier_char)));
 template <class T> constexpr auto c_keyword(T t) {
 	return sequence(t, not_(c_identifier_char));
 }
@@ -9,30 +13,30 @@ template <class... T> constexpr auto c_keywords(T... arguments) {
 	return choice(c_keyword(arguments)...);
 }
 
-constexpr auto c_comment = choice(
+constexpr auto c_comment = named("c_comment", choice(
 	sequence("/*", repetition(any_char_but("*/")), optional("*/")),
 	sequence("//", repetition(any_char_but('\n')))
-);
-constexpr auto c_escape = sequence('\\', choice(
+));
+constexpr auto c_escape = named("c_escape", sequence('\\', choice(
 	'a', 'b', 't', 'n', 'v', 'f', 'r',
 	'"', '\'', '?', '\\',
 	repetition<1, 3>(range('0', '7')),
 	sequence('x', one_or_more(hex_digit)),
 	sequence('u', repetition<4, 4>(hex_digit)),
 	sequence('U', repetition<8, 8>(hex_digit))
-));
-constexpr auto c_string = sequence(
+)));
+constexpr auto c_string = named("c_string", sequence(
 	optional(choice('L', "u8", 'u', 'U')),
 	'"',
 	repetition(choice(highlight(Style::ESCAPE, c_escape), any_char_but(choice('"', '\n')))),
 	optional('"')
-);
-constexpr auto c_character = sequence(
+));
+constexpr auto c_character = named("c_character", sequence(
 	optional(choice('L', "u8", 'u', 'U')),
 	'\'',
 	repetition(choice(highlight(Style::ESCAPE, c_escape), any_char_but(choice('\'', '\n')))),
 	optional('\'')
-);
+));
 
 constexpr auto c_digits = sequence(
 	range('0', '9'),
@@ -46,7 +50,7 @@ constexpr auto c_binary_digits = sequence(
 	range('0', '1'),
 	zero_or_more(sequence(optional('\''), range('0', '1')))
 );
-constexpr auto c_number = sequence(
+constexpr auto c_number = named("c_number", sequence(
 	choice(
 		// hexadecimal
 		sequence(
@@ -85,8 +89,8 @@ constexpr auto c_number = sequence(
 	),
 	// suffix
 	zero_or_more(choice('u', 'U', 'l', 'L', 'f', 'F'))
-);
-constexpr auto c_preprocessor = sequence(
+));
+constexpr auto c_preprocessor = named("c_preprocessor", sequence(
 	'#',
 	zero_or_more(choice(' ', '\t')),
 	choice(
@@ -117,10 +121,10 @@ constexpr auto c_preprocessor = sequence(
 		c_keyword("pragma"),
 		c_keyword("embed")
 	)
-);
+));
 
-struct c_file_name {
-	static constexpr auto expression = ends_with(".c");
+struct c_file_type: FileType {
+	static constexpr const char* extensions = "c";
 };
 
 struct c_language {
@@ -135,7 +139,7 @@ struct c_language {
 		// numbers
 		highlight(Style::LITERAL, c_number),
 		// keywords
-		highlight(Style::KEYWORD, c_keywords(
+		highlight(Style::KEYWORD, named("c_keywords", c_keywords(
 			"if",
 			"else",
 			"for",
@@ -156,9 +160,9 @@ struct c_language {
 			"static",
 			"extern",
 			"inline"
-		)),
+		))),
 		// types
-		highlight(Style::TYPE, c_keywords(
+		highlight(Style::TYPE, named("c_types", c_keywords(
 			"void",
 			"char",
 			"short",
@@ -168,7 +172,7 @@ struct c_language {
 			"double",
 			"unsigned",
 			"signed"
-		)),
+		))),
 		// operators
 		highlight(Style::OPERATOR, c_keyword(
 			"sizeof"
@@ -0,0 +1,3 @@
+#include "haskell.hpp"
+
+const Language prism::languages::haskell = language<haskell_file_type, haskell_language>("Haskell");
@@ -1,6 +1,22 @@
 // https://www.haskell.org/onlinereport/haskell2010/haskellch2.html
 
-constexpr auto haskell_identifier_char = choice(range('a', 'z'), '_', range('A', 'Z'), range('0', '9'), '\'');
+#pragma once
+
+#include "c.hpp"
+
+// identifiers that start with a non-ASCII letter are treated like variables
+constexpr auto haskell_variable_begin_char = unicode_char<UnicodeProperty::XID_START>([](char c) {
+	return (c >= 'a' && c <= 'z') || c == '_';
+});
+constexpr auto haskell_identifier_char = unicode_char<UnicodeProperty::XID_CONTINUE>([](char c) {
+	return (c >= 'a' && c <= 'z') || c == '_' || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '\'';
+});
+template <class T> constexpr auto haskell_keyword(T t) {
+	return sequence(t, not_(haskell_identifier_char));
+}
+template <class... T> constexpr auto haskell_keywords(T... arguments) {
+	return choice(haskell_keyword(arguments)...);
+}
 constexpr auto haskell_operator_char = choice('!', '#', '$', '%', '&', '*', '+', '.', '/', '<', '=', '>', '?', '@', '\\', '^', '|', '-', '~', ':');
 
 struct haskell_block_comment {
@@ -13,20 +29,20 @@ struct haskell_block_comment {
 		optional("-}")
 	);
 };
-constexpr auto haskell_comment = choice(
+constexpr auto haskell_comment = named("haskell_comment", choice(
 	reference<haskell_block_comment>(),
 	sequence(repetition<2>('-'), not_(haskell_operator_char), repetition(any_char_but('\n')))
-);
+));
 
-constexpr auto haskell_escape = sequence('\\', choice(
+constexpr auto haskell_escape = named("haskell_escape", sequence('\\', choice(
 	'a', 'b', 'f', 'n', 'r', 't', 'v', '\\', '"', '\'', '&',
 	sequence('^', choice(range('A', 'Z'), '@', '[', '\\', ']', '^', '_')),
 	"NUL", "SOH", "STX", "ETX", "EOT", "ENQ", "ACK", "BEL", "BS", "HT", "LF", "VT", "FF", "CR", "SO", "SI", "DLE", "DC1", "DC2", "DC3", "DC4", "NAK", "SYN", "ETB", "CAN", "EM", "SUB", "ESC", "FS", "GS", "RS", "US", "SP", "DEL",
 	one_or_more(range('0', '9')),
 	sequence('o', one_or_more(range('0', '7'))),
 	sequence('x', one_or_more(hex_digit))
-));
-constexpr auto haskell_string = sequence(
+)));
+constexpr auto haskell_string = named("haskell_string", sequence(
 	'"',
 	repetition(choice(
 		highlight(Style::ESCAPE, haskell_escape),
@@ -34,14 +50,14 @@ constexpr auto haskell_string = sequence(
 		any_char_but(choice('"', '\n'))
 	)),
 	optional('"')
-);
-constexpr auto haskell_character = sequence(
+));
+constexpr auto haskell_character = named("haskell_character", sequence(
 	'\'',
 	repetition(choice(highlight(Style::ESCAPE, haskell_escape), any_char_but(choice('\'', '\n')))),
 	optional('\'')
-);
+));
 
-constexpr auto haskell_number = choice(
+constexpr auto haskell_number = named("haskell_number", choice(
 	// hexadecimal
 	sequence(
 		'0',
@@ -68,18 +84,19 @@ constexpr auto haskell_number = choice(
 			one_or_more(range('0', '9'))
 		))
 	)
-);
+));
 
-constexpr auto haskell_module = sequence(
+constexpr auto haskell_module = named("haskell_module", sequence(
 	highlight(Style::TYPE, sequence(range('A', 'Z'), zero_or_more(haskell_identifier_char))),
 	zero_or_more(sequence(
 		'.',
 		highlight(Style::TYPE, sequence(range('A', 'Z'), zero_or_more(haskell_identifier_char)))
 	))
-);
+));
 
-struct haskell_file_name {
-	static constexpr auto expression = ends_with(".hs");
+struct haskell_file_type: FileType {
+	static constexpr const char* extensions = "hs";
+	static constexpr auto content = choice(shebang("runhaskell"), shebang("runghc"));
 };
 
 struct haskell_language {
@@ -94,7 +111,7 @@ struct haskell_language {
 		// numbers
 		highlight(Style::LITERAL, haskell_number),
 		// keywords
-		highlight(Style::KEYWORD, c_keywords(
+		highlight(Style::KEYWORD, named("haskell_keywords", haskell_keywords(
 			"if",
 			"then",
 			"else",
@@ -110,18 +127,18 @@ struct haskell_language {
 			"class",
 			"instance",
 			"module"
-		)),
+		))),
 		// imports
 		sequence(
-			highlight(Style::KEYWORD, c_keyword("import")),
+			highlight(Style::KEYWORD, haskell_keyword("import")),
 			zero_or_more(' '),
-			optional(highlight(Style::KEYWORD, c_keyword("qualified"))),
+			optional(highlight(Style::KEYWORD, haskell_keyword("qualified"))),
 			zero_or_more(' '),
 			optional(haskell_module),
 			zero_or_more(' '),
 			optional(choice(
-				highlight(Style::KEYWORD, c_keyword("hiding")),
-				highlight(Style::KEYWORD, c_keyword("as"))
+				highlight(Style::KEYWORD, haskell_keyword("hiding")),
+				highlight(Style::KEYWORD, haskell_keyword("as"))
 			))
 		),
 		// qualified operators and identifiers
@@ -131,12 +148,12 @@ struct haskell_language {
 				'.',
 				choice(
 					highlight(Style::OPERATOR, one_or_more(haskell_operator_char)),
-					sequence(choice(range('a', 'z'), '_'), zero_or_more(haskell_identifier_char))
+					sequence(haskell_variable_begin_char, zero_or_more(haskell_identifier_char))
 				)
 			))
 		),
 		// unqualified operators and identifiers
 		highlight(Style::OPERATOR, one_or_more(haskell_operator_char)),
-		sequence(choice(range('a', 'z'), '_'), zero_or_more(haskell_identifier_char))
+		sequence(haskell_variable_begin_char, zero_or_more(haskell_identifier_char))
 	);
 };
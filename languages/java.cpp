@@ -0,0 +1,3 @@
+#include "java.hpp"
+
+const Language prism::languages::java = language<java_file_type, java_language>("Java");
@@ -1,8 +1,16 @@
 // https://docs.oracle.com/javase/specs/jls/se17/html/jls-3.html
 
-constexpr auto java_identifier_begin_char = choice(range('a', 'z'), range('A', 'Z'), '$', '_');
-constexpr auto java_identifier_char = choice(range('a', 'z'), range('A', 'Z'), '$', '_', range('0', '9'));
-constexpr auto java_identifier = sequence(java_identifier_begin_char, zero_or_more(java_identifier_char));
+#pragma once
+
+#include "c.hpp"
+
+constexpr auto java_identifier_begin_char = unicode_char<UnicodeProperty::XID_START>([](char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '$' || c == '_';
+});
+constexpr auto java_identifier_char = unicode_char<UnicodeProperty::XID_CONTINUE>([](char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '$' || c == '_';
+});
+constexpr auto java_identifier = named("java_identifier", sequence(java_identifier_begin_char, zero_or_more(java_identifier_char)));
 template <class T> constexpr auto java_keyword(T t) {
 	return sequence(t, not_(java_identifier_char));
 }
@@ -10,13 +18,13 @@ template <class... T> constexpr auto java_keywords(T... arguments) {
 	return choice(java_keyword(arguments)...);
 }
 
-constexpr auto java_escape = sequence('\\', choice(
+constexpr auto java_escape = named("java_escape", sequence('\\', choice(
 	'b', 't', 'n', 'f', 'r', 's',
 	'"', '\'', '\\',
 	repetition<1, 3>(range('0', '7')),
 	sequence(one_or_more('u'), repetition<4, 4>(hex_digit))
-));
-constexpr auto java_string = choice(
+)));
+constexpr auto java_string = named("java_string", choice(
 	sequence(
 		"\"\"\"",
 		zero_or_more(' '),
@@ -29,12 +37,12 @@ constexpr auto java_string = choice(
 		repetition(choice(highlight(Style::ESCAPE, java_escape), any_char_but(choice('"', '\n')))),
 		optional('"')
 	)
-);
-constexpr auto java_character = sequence(
+));
+constexpr auto java_character = named("java_character", sequence(
 	'\'',
 	repetition(choice(highlight(Style::ESCAPE, java_escape), any_char_but(choice('\'', '\n')))),
 	optional('\'')
-);
+));
 
 constexpr auto java_digits = sequence(
 	range('0', '9'),
@@ -48,7 +56,7 @@ constexpr auto java_binary_digits = sequence(
 	range('0', '1'),
 	zero_or_more(sequence(zero_or_more('_'), range('0', '1')))
 );
-constexpr auto java_number = sequence(
+constexpr auto java_number = named("java_number", sequence(
 	choice(
 		// hexadecimal
 		sequence(
@@ -87,10 +95,10 @@ constexpr auto java_number = sequence(
 	),
 	// suffix
 	optional(choice('l', 'L', 'f', 'F', 'd', 'D'))
-);
+));
 
-struct java_file_name {
-	static constexpr auto expression = ends_with(".java");
+struct java_file_type: FileType {
+	static constexpr const char* extensions = "java";
 };
 
 struct java_language {
@@ -103,13 +111,13 @@ struct java_language {
 		// numbers
 		highlight(Style::LITERAL, java_number),
 		// literals
-		highlight(Style::LITERAL, java_keywords(
+		highlight(Style::LITERAL, named("java_literals", java_keywords(
 			"null",
 			"false",
 			"true"
-		)),
+		))),
 		// keywords
-		highlight(Style::KEYWORD, java_keywords(
+		highlight(Style::KEYWORD, named("java_keywords", java_keywords(
 			"this",
 			"new",
 			"var",
@@ -143,9 +151,9 @@ struct java_language {
 			"throws",
 			"import",
 			"package"
-		)),
+		))),
 		// types
-		highlight(Style::TYPE, java_keywords(
+		highlight(Style::TYPE, named("java_types", java_keywords(
 			"void",
 			"boolean",
 			"char",
@@ -155,7 +163,7 @@ struct java_language {
 			"long",
 			"float",
 			"double"
-		)),
+		))),
 		// identifiers
 		java_identifier
 	);
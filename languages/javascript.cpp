@@ -0,0 +1,3 @@
+#include "javascript.hpp"
+
+const Language prism::languages::javascript = language<javascript_file_type, javascript_language>("JavaScript");
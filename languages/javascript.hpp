@@ -1,8 +1,13 @@
 // https://developer.mozilla.org/en-US/docs/Web/JavaScript/Reference/Lexical_grammar
 
+#pragma once
+
+#include "c.hpp"
+#include "java.hpp"
+
 struct javascript_language;
 
-constexpr auto javascript_escape = sequence('\\', choice(
+constexpr auto javascript_escape = named("javascript_escape", sequence('\\', choice(
 	'b', 't', 'n', 'v', 'f', 'r',
 	'"', '$', '\'', '\\', '`',
 	'0',
@@ -10,8 +15,8 @@ constexpr auto javascript_escape = sequence('\\', choice(
 	sequence('x', repetition<2, 2>(hex_digit)),
 	sequence('u', repetition<4, 4>(hex_digit)),
 	sequence("u{", one_or_more(hex_digit), '}')
-));
-constexpr auto javascript_template_string = sequence(
+)));
+constexpr auto javascript_template_string = named("javascript_template_string", sequence(
 	'`',
 	repetition(choice(
 		highlight(Style::ESCAPE, javascript_escape),
@@ -23,8 +28,8 @@ constexpr auto javascript_template_string = sequence(
 		any_char_but('`')
 	)),
 	optional('`')
-);
-constexpr auto javascript_string = choice(
+));
+constexpr auto javascript_string = named("javascript_string", choice(
 	sequence(
 		'"',
 		repetition(choice(highlight(Style::ESCAPE, javascript_escape), any_char_but(choice('"', '\n')))),
@@ -36,13 +41,13 @@ constexpr auto javascript_string = choice(
 		optional('\'')
 	),
 	javascript_template_string
-);
+));
 
 constexpr auto javascript_digits = sequence(
 	range('0', '9'),
 	zero_or_more(sequence(optional('_'), range('0', '9')))
 );
-constexpr auto javascript_number = sequence(
+constexpr auto javascript_number = named("javascript_number", sequence(
 	choice(
 		// hexadecimal
 		sequence(
@@ -81,10 +86,11 @@ constexpr auto javascript_number = sequence(
 	),
 	// suffix
 	optional('n')
-);
+));
 
-struct javascript_file_name {
-	static constexpr auto expression = ends_with(".js");
+struct javascript_file_type: FileType {
+	static constexpr const char* extensions = "js";
+	static constexpr auto content = shebang("node");
 };
 
 struct javascript_language {
@@ -96,13 +102,13 @@ struct javascript_language {
 		// numbers
 		highlight(Style::LITERAL, javascript_number),
 		// literals
-		highlight(Style::LITERAL, java_keywords(
+		highlight(Style::LITERAL, named("javascript_literals", java_keywords(
 			"null",
 			"false",
 			"true"
-		)),
+		))),
 		// keywords
-		highlight(Style::KEYWORD, java_keywords(
+		highlight(Style::KEYWORD, named("javascript_keywords", java_keywords(
 			"this",
 			"new",
 			"var",
@@ -134,7 +140,7 @@ struct javascript_language {
 			"static",
 			"import",
 			"export"
-		)),
+		))),
 		sequence(
 			'{',
 			repetition(sequence(not_('}'), choice(reference<javascript_language>(), any_char()))),
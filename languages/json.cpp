@@ -0,0 +1,133 @@
+#include "json.hpp"
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#endif
+
+// a hand-written version of json_language for large files
+// runs of bytes that the grammar consumes one iteration at a time are found with a bitmask scan and skipped at once,
+// everything else is parsed by the grammar's own expressions, so spans and checkpoints are identical to the grammar
+
+// bytes outside of strings that can only be consumed by any_char() of the root scope
+static bool is_plain_char(char c) {
+	return !(c == '"' || c == '-' || (c >= '0' && c <= '9') || c == 'n' || c == 'f' || c == 't' || c == '\0');
+}
+// bytes inside of strings that can only be consumed by any_char_but() of json_string_char
+static bool is_plain_string_char(char c) {
+	return !(c == '"' || c == '\\' || c == '\n' || c == '\0');
+}
+
+#if defined(__SSE2__) && defined(__GNUC__)
+// the bits of the bytes that end a run, 16 bytes at a time
+static unsigned get_plain_mask(__m128i bytes) {
+	const __m128i digits = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+	__m128i mask = _mm_cmpeq_epi8(_mm_max_epu8(digits, _mm_set1_epi8(9)), _mm_set1_epi8(9));
+	mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')));
+	mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('-')));
+	mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('n')));
+	mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('f')));
+	mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('t')));
+	mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+	return _mm_movemask_epi8(mask);
+}
+static unsigned get_plain_string_mask(__m128i bytes) {
+	__m128i mask = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"'));
+	mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\')));
+	mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')));
+	mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+	return _mm_movemask_epi8(mask);
+}
+#endif
+
+// the length of the run at the start of the current chunk
+template <bool in_string> static std::size_t scan_run(const StringView& chunk) {
+	std::size_t i = 0;
+#if defined(__SSE2__) && defined(__GNUC__)
+	for (; i + 16 <= chunk.size(); i += 16) {
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk.data() + i));
+		const unsigned mask = in_string ? get_plain_string_mask(bytes) : get_plain_mask(bytes);
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+	for (; i < chunk.size(); ++i) {
+		if (!(in_string ? is_plain_string_char(chunk[i]) : is_plain_char(chunk[i]))) {
+			break;
+		}
+	}
+	return i;
+}
+
+// consumes a run of bytes that are separate iterations of the current repetition, returns true if parsing has to stop
+static bool skip_iterations(ParseContext& context, std::size_t size) {
+	const std::size_t end = context.get_position() + size;
+	while (true) {
+		const std::size_t next = std::max(context.get_next_checkpoint(), context.get_position() + 1);
+		if (next > end) {
+			context.advance(end - context.get_position());
+			return false;
+		}
+		context.advance(next - context.get_position());
+		if (context.add_checkpoint()) {
+			return true;
+		}
+	}
+}
+
+// repetition(t) with runs of bytes for which the template argument is true skipped at once
+template <bool in_string, class T> static Result parse_repetition(ParseContext& context, const T& t) {
+	return context.add_scope([&]() {
+		context.skip_to_checkpoint();
+		while (true) {
+			if (const std::size_t size = scan_run<in_string>(context.get_chunk())) {
+				if (skip_iterations(context, size)) {
+					return Result::PARTIAL_SUCCESS;
+				}
+				continue;
+			}
+			const Result result = t.template parse<true>(context);
+			if (result != Result::SUCCESS) {
+				return result == Result::FAILURE ? Result::SUCCESS : result;
+			}
+			if (context.add_checkpoint()) {
+				return Result::PARTIAL_SUCCESS;
+			}
+		}
+	});
+}
+
+// highlight(Style::STRING, json_string) with the fast repetition
+static Result parse_string(ParseContext& context) {
+	const int old_style = context.change_style(Style::STRING);
+	context.advance();
+	const Result result = parse_repetition<true>(context, json_string_char);
+	if (result == Result::SUCCESS && context.get() == '"') {
+		context.advance();
+	}
+	context.change_style(old_style);
+	return result;
+}
+
+static constexpr auto json_root_char = choice(reference<json_language>(), any_char());
+
+// the JSON strings are parsed by parse_string, everything else by the grammar
+struct json_value {
+	template <bool can_checkpoint> Result parse(ParseContext& context) const {
+		if (context.get() == '"') {
+			return parse_string(context);
+		}
+		return json_root_char.template parse<true>(context);
+	}
+};
+
+#ifdef PRISM_PROFILE
+// the profiler needs the named rules of the grammar
+const Language prism::languages::json = language<json_file_type, json_language>("JSON");
+#else
+static void parse_json_fast(ParseContext& context) {
+	parse_repetition<false>(context, json_value());
+}
+
+static constexpr Language json_grammar = language<json_file_type, json_language>("JSON");
+const Language prism::languages::json = {json_grammar.name, json_grammar.file_extensions, json_grammar.parse_content, parse_json_fast, json_grammar.version};
+#endif
@@ -1,17 +1,23 @@
 // https://www.json.org/json-en.html
 
-constexpr auto json_escape = sequence('\\', choice(
+#pragma once
+
+#include "c.hpp"
+#include "java.hpp"
+
+constexpr auto json_escape = named("json_escape", sequence('\\', choice(
 	'b', 't', 'n', 'f', 'r',
 	'"', '\\', '/',
 	sequence('u', repetition<4, 4>(hex_digit))
-));
-constexpr auto json_string = sequence(
+)));
+constexpr auto json_string_char = choice(highlight(Style::ESCAPE, json_escape), any_char_but(choice('"', '\n')));
+constexpr auto json_string = named("json_string", sequence(
 	'"',
-	repetition(choice(highlight(Style::ESCAPE, json_escape), any_char_but(choice('"', '\n')))),
+	repetition(json_string_char),
 	optional('"')
-);
+));
 
-constexpr auto json_number = sequence(
+constexpr auto json_number = named("json_number", sequence(
 	optional('-'),
 	one_or_more(range('0', '9')),
 	optional(sequence(
@@ -24,10 +30,14 @@ constexpr auto json_number = sequence(
 		optional(choice('+', '-')),
 		one_or_more(range('0', '9'))
 	))
-);
+));
 
-struct json_file_name {
-	static constexpr auto expression = ends_with(".json");
+struct json_file_type: FileType {
+	static constexpr const char* extensions = "json";
+	static constexpr auto content = sequence(zero_or_more(c_whitespace_char), choice(
+		'{',
+		sequence('[', zero_or_more(c_whitespace_char), choice('{', '[', ']', '"', '-', range('0', '9'), "true", "false", "null"))
+	));
 };
 
 struct json_language {
@@ -37,10 +47,10 @@ struct json_language {
 		// numbers
 		highlight(Style::LITERAL, json_number),
 		// literals
-		highlight(Style::LITERAL, java_keywords(
+		highlight(Style::LITERAL, named("json_literals", java_keywords(
 			"null",
 			"false",
 			"true"
-		))
+		)))
 	);
 };
@@ -0,0 +1,3 @@
+#include "python.hpp"
+
+const Language prism::languages::python = language<python_file_type, python_language>("Python");
@@ -1,8 +1,26 @@
 // https://docs.python.org/3/reference/lexical_analysis.html
 
-constexpr auto python_comment = sequence('#', repetition(any_char_but('\n')));
-constexpr auto python_escape = sequence('\\', any_char());
-constexpr auto python_string = choice(
+#pragma once
+
+#include "c.hpp"
+
+constexpr auto python_identifier_begin_char = unicode_char<UnicodeProperty::XID_START>([](char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+});
+constexpr auto python_identifier_char = unicode_char<UnicodeProperty::XID_CONTINUE>([](char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+});
+constexpr auto python_identifier = named("python_identifier", sequence(python_identifier_begin_char, zero_or_more(python_identifier_char)));
+template <class T> constexpr auto python_keyword(T t) {
+	return sequence(t, not_(python_identifier_char));
+}
+template <class... T> constexpr auto python_keywords(T... arguments) {
+	return choice(python_keyword(arguments)...);
+}
+
+constexpr auto python_comment = named("python_comment", sequence('#', repetition(any_char_but('\n'))));
+constexpr auto python_escape = named("python_escape", sequence('\\', any_char()));
+constexpr auto python_string = named("python_string", choice(
 	sequence(
 		"\"\"\"",
 		repetition(choice(highlight(Style::ESCAPE, python_escape), any_char_but("\"\"\""))),
@@ -23,12 +41,12 @@ constexpr auto python_string = choice(
 		repetition(choice(highlight(Style::ESCAPE, python_escape), any_char_but(choice('\'', '\n')))),
 		optional('\'')
 	)
-);
+));
 constexpr auto python_digits = sequence(
 	range('0', '9'),
 	zero_or_more(sequence(optional('_'), range('0', '9')))
 );
-constexpr auto python_number = choice(
+constexpr auto python_number = named("python_number", choice(
 	// hexadecimal
 	sequence(
 		'0',
@@ -60,10 +78,11 @@ constexpr auto python_number = choice(
 			python_digits
 		))
 	)
-);
+));
 
-struct python_file_name {
-	static constexpr auto expression = ends_with(".py");
+struct python_file_type: FileType {
+	static constexpr const char* extensions = "py";
+	static constexpr auto content = shebang("python");
 };
 
 struct python_language {
@@ -77,23 +96,23 @@ struct python_language {
 		// numbers
 		highlight(Style::LITERAL, python_number),
 		// literals
-		highlight(Style::LITERAL, c_keywords(
+		highlight(Style::LITERAL, named("python_literals", python_keywords(
 			"None",
 			"False",
 			"True"
-		)),
+		))),
 		// keywords
 		sequence(
-			highlight(Style::KEYWORD, c_keyword("def")),
+			highlight(Style::KEYWORD, python_keyword("def")),
 			zero_or_more(' '),
-			optional(highlight(Style::FUNCTION, c_identifier))
+			optional(highlight(Style::FUNCTION, python_identifier))
 		),
 		sequence(
-			highlight(Style::KEYWORD, c_keyword("class")),
+			highlight(Style::KEYWORD, python_keyword("class")),
 			zero_or_more(' '),
-			optional(highlight(Style::TYPE, c_identifier))
+			optional(highlight(Style::TYPE, python_identifier))
 		),
-		highlight(Style::KEYWORD, c_keywords(
+		highlight(Style::KEYWORD, named("python_keywords", python_keywords(
 			"lambda",
 			"if",
 			"elif",
@@ -111,15 +130,15 @@ struct python_language {
 			"await",
 			"async",
 			"import"
-		)),
+		))),
 		// operators
-		highlight(Style::OPERATOR, c_keywords(
+		highlight(Style::OPERATOR, named("python_operators", python_keywords(
 			"and",
 			"or",
 			"not",
 			"is",
 			"in"
-		)),
+		))),
 		choice(
 			"+=", "-=", "*=", "/=", "%=", "**=", "//=", "&=", "|=", "^=", "<<=", ">>=",
 			"**", "//",
@@ -131,6 +150,6 @@ struct python_language {
 			'='
 		),
 		// identifiers
-		c_identifier
+		python_identifier
 	);
 };
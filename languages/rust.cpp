@@ -0,0 +1,3 @@
+#include "rust.hpp"
+
+const Language prism::languages::rust = language<rust_file_type, rust_language>("Rust");
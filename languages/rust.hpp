@@ -1,5 +1,23 @@
 // https://doc.rust-lang.org/reference/index.html
 
+#pragma once
+
+#include "c.hpp"
+
+constexpr auto rust_identifier_begin_char = unicode_char<UnicodeProperty::XID_START>([](char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+});
+constexpr auto rust_identifier_char = unicode_char<UnicodeProperty::XID_CONTINUE>([](char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+});
+constexpr auto rust_identifier = named("rust_identifier", sequence(rust_identifier_begin_char, zero_or_more(rust_identifier_char)));
+template <class T> constexpr auto rust_keyword(T t) {
+	return sequence(t, not_(rust_identifier_char));
+}
+template <class... T> constexpr auto rust_keywords(T... arguments) {
+	return choice(rust_keyword(arguments)...);
+}
+
 struct rust_block_comment {
 	static constexpr auto expression = sequence(
 		"/*",
@@ -10,36 +28,36 @@ struct rust_block_comment {
 		optional("*/")
 	);
 };
-constexpr auto rust_comment = choice(
+constexpr auto rust_comment = named("rust_comment", choice(
 	reference<rust_block_comment>(),
 	sequence("//", repetition(any_char_but('\n')))
-);
-constexpr auto rust_escape = sequence('\\', choice(
+));
+constexpr auto rust_escape = named("rust_escape", sequence('\\', choice(
 	't', 'n', 'r',
 	'"', '\'', '\\',
 	'0',
 	sequence('x', repetition<2, 2>(hex_digit)),
 	sequence("u{", repetition<1, 6>(sequence(hex_digit, zero_or_more('_'))), '}')
-));
-constexpr auto rust_string = sequence(
+)));
+constexpr auto rust_string = named("rust_string", sequence(
 	optional(choice('b', 'c')),
 	'"',
 	repetition(choice(highlight(Style::ESCAPE, rust_escape), any_char_but('"'))),
 	optional('"')
-);
-constexpr auto rust_character = sequence(
+));
+constexpr auto rust_character = named("rust_character", sequence(
 	optional('b'),
 	'\'',
 	choice(highlight(Style::ESCAPE, rust_escape), any_char_but(choice('\'', '\n'))),
 	'\''
-);
-constexpr auto rust_lifetime = sequence('\'', c_identifier);
+));
+constexpr auto rust_lifetime = named("rust_lifetime", sequence('\'', rust_identifier));
 
 constexpr auto rust_digits = sequence(
 	range('0', '9'),
 	zero_or_more(choice(range('0', '9'), '_'))
 );
-constexpr auto rust_number = sequence(
+constexpr auto rust_number = named("rust_number", sequence(
 	choice(
 		// hexadecimal
 		sequence(
@@ -86,10 +104,10 @@ constexpr auto rust_number = sequence(
 		),
 		sequence('f', choice("32", "64"))
 	))
-);
+));
 
-struct rust_file_name {
-	static constexpr auto expression = ends_with(".rs");
+struct rust_file_type: FileType {
+	static constexpr const char* extensions = "rs";
 };
 
 struct rust_language {
@@ -106,12 +124,12 @@ struct rust_language {
 		// lifetimes
 		highlight(Style::LITERAL, rust_lifetime),
 		// literals
-		highlight(Style::LITERAL, c_keywords(
+		highlight(Style::LITERAL, named("rust_literals", rust_keywords(
 			"false",
 			"true"
-		)),
+		))),
 		// keywords
-		highlight(Style::KEYWORD, c_keywords(
+		highlight(Style::KEYWORD, named("rust_keywords", rust_keywords(
 			"let",
 			"mut",
 			"if",
@@ -137,9 +155,9 @@ struct rust_language {
 			"pub",
 			"use",
 			"mod"
-		)),
+		))),
 		// types
-		highlight(Style::TYPE, c_keywords(
+		highlight(Style::TYPE, named("rust_types", rust_keywords(
 			"bool",
 			"char",
 			sequence(
@@ -148,8 +166,8 @@ struct rust_language {
 			),
 			sequence('f', choice("32", "64")),
 			"str"
-		)),
+		))),
 		// identifiers
-		c_identifier
+		rust_identifier
 	);
 };
@@ -0,0 +1,3 @@
+#include "toml.hpp"
+
+const Language prism::languages::toml = language<toml_file_type, toml_language>("TOML");
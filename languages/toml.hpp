@@ -1,14 +1,18 @@
 // https://toml.io/en/v1.0.0
 
-constexpr auto toml_comment = sequence('#', repetition(any_char_but('\n')));
+#pragma once
 
-constexpr auto toml_escape = sequence('\\', choice(
+#include "c.hpp"
+
+constexpr auto toml_comment = named("toml_comment", sequence('#', repetition(any_char_but('\n'))));
+
+constexpr auto toml_escape = named("toml_escape", sequence('\\', choice(
 	'b', 't', 'n', 'f', 'r',
 	'"', '\\',
 	sequence('u', repetition<4, 4>(hex_digit)),
 	sequence('U', repetition<8, 8>(hex_digit))
-));
-constexpr auto toml_string = choice(
+)));
+constexpr auto toml_string = named("toml_string", choice(
 	sequence(
 		"\"\"\"",
 		repetition(choice(highlight(Style::ESCAPE, toml_escape), any_char_but("\"\"\""))),
@@ -29,13 +33,13 @@ constexpr auto toml_string = choice(
 		repetition(any_char_but(choice('\'', '\n'))),
 		optional('\'')
 	)
-);
+));
 
 constexpr auto toml_digits = sequence(
 	range('0', '9'),
 	zero_or_more(sequence(optional('_'), range('0', '9')))
 );
-constexpr auto toml_number = choice(
+constexpr auto toml_number = named("toml_number", choice(
 	// hexadecimal
 	sequence(
 		"0x",
@@ -69,10 +73,10 @@ constexpr auto toml_number = choice(
 			toml_digits
 		))
 	)
-);
+));
 
-struct toml_file_name {
-	static constexpr auto expression = ends_with(".toml");
+struct toml_file_type: FileType {
+	static constexpr const char* extensions = "toml";
 };
 
 struct toml_language {
@@ -84,9 +88,9 @@ struct toml_language {
 		// numbers
 		highlight(Style::LITERAL, toml_number),
 		// literals
-		highlight(Style::LITERAL, c_keywords(
+		highlight(Style::LITERAL, named("toml_literals", c_keywords(
 			"false",
 			"true"
-		))
+		)))
 	);
 };
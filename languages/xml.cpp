@@ -0,0 +1,3 @@
+#include "xml.hpp"
+
+const Language prism::languages::xml = language<xml_file_type, xml_language>("XML");
@@ -1,12 +1,16 @@
 // https://www.w3.org/TR/REC-xml/
 
-constexpr auto xml_comment = sequence("<!--", repetition(any_char_but("-->")), optional("-->"));
+#pragma once
+
+#include "javascript.hpp"
+
+constexpr auto xml_comment = named("xml_comment", sequence("<!--", repetition(any_char_but("-->")), optional("-->")));
 
 constexpr auto xml_white_space = zero_or_more(choice(' ', '\t', '\n', '\r'));
 constexpr auto xml_name_start_char = choice(range('a', 'z'), range('A', 'Z'), ':', '_');
 constexpr auto xml_name_char = choice(xml_name_start_char, '-', '.', range('0', '9'));
-constexpr auto xml_name = sequence(xml_name_start_char, zero_or_more(xml_name_char));
-constexpr auto xml_escape = sequence(
+constexpr auto xml_name = named("xml_name", sequence(xml_name_start_char, zero_or_more(xml_name_char)));
+constexpr auto xml_escape = named("xml_escape", sequence(
 	'&',
 	choice(
 		sequence('#', one_or_more(range('0', '9'))),
@@ -14,8 +18,8 @@ constexpr auto xml_escape = sequence(
 		xml_name
 	),
 	';'
-);
-constexpr auto xml_string = choice(
+));
+constexpr auto xml_string = named("xml_string", choice(
 	sequence(
 		'"',
 		repetition(choice(highlight(Style::ESCAPE, xml_escape), any_char_but(choice('"', '<')))),
@@ -26,27 +30,31 @@ constexpr auto xml_string = choice(
 		repetition(choice(highlight(Style::ESCAPE, xml_escape), any_char_but(choice('\'', '<')))),
 		optional('\'')
 	)
-);
+));
+
+constexpr auto xml_attributes = highlight(Style::TYPE, repetition(sequence(
+	xml_name,
+	xml_white_space,
+	'=',
+	xml_white_space,
+	highlight(Style::STRING, xml_string),
+	xml_white_space
+)));
 
-struct xml_file_name {
-	static constexpr auto expression = ends_with(choice(".xml", ".svg"));
+struct xml_file_type: FileType {
+	static constexpr const char* extensions = "xml svg";
+	static constexpr auto content = choice("<?xml", "<svg");
 };
 
 struct xml_language {
 	static constexpr auto expression = choice(
 		highlight(Style::COMMENT, xml_comment),
+		embed<javascript_language>(highlight(Style::KEYWORD, sequence("<script", xml_white_space, xml_attributes, '>')), "</script>"),
 		highlight(Style::KEYWORD, sequence(
 			'<',
 			xml_name,
 			xml_white_space,
-			highlight(Style::TYPE, repetition(sequence(
-				xml_name,
-				xml_white_space,
-				'=',
-				xml_white_space,
-				highlight(Style::STRING, xml_string),
-				xml_white_space
-			))),
+			xml_attributes,
 			optional(choice('>', "/>"))
 		)),
 		highlight(Style::KEYWORD, sequence("</", xml_name, xml_white_space, optional('>'))),
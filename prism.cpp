@@ -1,4 +1,9 @@
-#include "prism.hpp"
+#include "grammar.hpp"
+#include "unicode.hpp"
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <random>
 
 #include "themes/one_dark.hpp"
 #include "themes/monokai.hpp"
@@ -17,43 +22,47 @@ const Theme& prism::get_theme(const char* name) {
 	return one_dark_theme;
 }
 
-class InputAdapter {
-	const Input* input;
-	Input::Chunk chunk;
-	std::size_t offset;
-	std::size_t i;
-public:
-	InputAdapter(const Input* input): input(input), chunk({nullptr, nullptr, 0}), offset(0), i(0) {
-		set_position(0);
-	}
-	char get() const {
-		return i < chunk.size ? chunk.data[i] : '\0';
+Input::Chunk AppendableInput::get_chunk_by_index(std::size_t index) const {
+	// the chunk handle is the index of the chunk
+	const void* handle = reinterpret_cast<const void*>(index);
+	const std::size_t offset = index * CHUNK_SIZE;
+	// released chunks read as empty, an InputAdapter starts at position 0 before it moves to where parsing starts
+	if (index < first_chunk || offset >= size_) {
+		return {handle, nullptr, 0};
 	}
-	void advance() {
-		++i;
-		if (i == chunk.size) {
-			offset += chunk.size;
-			chunk = input->get_next_chunk(chunk.chunk);
-			i = 0;
+	return {handle, chunks[index - first_chunk].get(), std::min(CHUNK_SIZE, size_ - offset)};
+}
+void AppendableInput::append(const char* data, std::size_t size) {
+	while (size > 0) {
+		const std::size_t used = size_ % CHUNK_SIZE;
+		if (used == 0) {
+			chunks.emplace_back(new char[CHUNK_SIZE]);
 		}
+		const std::size_t n = std::min(size, CHUNK_SIZE - used);
+		std::copy(data, data + n, chunks.back().get() + used);
+		data += n;
+		size -= n;
+		size_ += n;
 	}
-	std::size_t get_position() const {
-		return offset + i;
-	}
-	void set_position(std::size_t pos) {
-		if (pos >= offset && pos - offset < chunk.size) {
-			i = pos - offset;
-		}
-		else {
-			auto chunk_pair = input->get_chunk(pos);
-			chunk = chunk_pair.first;
-			offset = chunk_pair.second;
-			i = pos - offset;
-		}
+}
+void AppendableInput::release(std::size_t pos) {
+	// the chunk that is currently appended to is never released
+	while (chunks.size() > 1 && (first_chunk + 1) * CHUNK_SIZE <= pos) {
+		chunks.pop_front();
+		++first_chunk;
 	}
-};
+}
+std::pair<Input::Chunk, std::size_t> AppendableInput::get_chunk(std::size_t pos) const {
+	const std::size_t index = pos / CHUNK_SIZE;
+	return {get_chunk_by_index(index), index * CHUNK_SIZE};
+}
+Input::Chunk AppendableInput::get_next_chunk(const void* chunk) const {
+	return get_chunk_by_index(reinterpret_cast<std::size_t>(chunk) + 1);
+}
 
-Cache::Node::Node(std::size_t start_pos, std::size_t start_max_pos): start_pos(start_pos), start_max_pos(start_max_pos) {}
+Cache::Node::Node(std::size_t start_pos, std::size_t start_max_pos, const allocator_type& allocator): start_pos(start_pos), start_max_pos(start_max_pos), checkpoints(allocator), children(allocator), end_pos(0), end_delimiter(nullptr) {}
+Cache::Node::Node(const Node& node, const allocator_type& allocator): start_pos(node.start_pos), start_max_pos(node.start_max_pos), checkpoints(node.checkpoints, allocator), children(node.children, allocator), end_pos(node.end_pos), end_delimiter(node.end_delimiter) {}
+Cache::Node::Node(Node&& node, const allocator_type& allocator): start_pos(node.start_pos), start_max_pos(node.start_max_pos), checkpoints(std::move(node.checkpoints), allocator), children(std::move(node.children), allocator), end_pos(node.end_pos), end_delimiter(node.end_delimiter) {}
 std::size_t Cache::Node::get_last_checkpoint() const {
 	if (checkpoints.empty()) {
 		return start_pos;
@@ -76,14 +85,17 @@ Cache::Node* Cache::Node::find_child(std::size_t pos) {
 	auto iter = std::lower_bound(children.begin(), children.end(), pos, [](const Node& child, std::size_t pos) {
 		return child.start_pos < pos;
 	});
-	if (iter != children.end()) {
+	if (iter != children.end() && iter->start_pos == pos) {
 		return &*iter;
 	}
 	return nullptr;
 }
 Cache::Node* Cache::Node::add_child(std::size_t pos, std::size_t max_pos) {
-	children.emplace_back(pos, max_pos);
-	return &children.back();
+	// a parse of an input that was cut off can take another path and add children before those of earlier parses
+	auto iter = std::upper_bound(children.begin(), children.end(), pos, [](std::size_t pos, const Node& child) {
+		return pos < child.start_pos;
+	});
+	return &*children.emplace(iter, pos, max_pos);
 }
 void Cache::Node::invalidate(std::size_t pos) {
 	{
@@ -102,532 +114,1687 @@ void Cache::Node::invalidate(std::size_t pos) {
 		children.back().invalidate(pos);
 	}
 }
-Cache::Cache(): root_node(0, 0) {}
+void Cache::Node::invalidate_end(std::size_t end) {
+	{
+		auto last = std::upper_bound(checkpoints.begin(), checkpoints.end(), end, [](std::size_t end, const Checkpoint& checkpoint) {
+			return end < checkpoint.pos;
+		});
+		auto first = std::lower_bound(checkpoints.begin(), last, end, [](const Checkpoint& checkpoint, std::size_t end) {
+			return checkpoint.max_pos < end;
+		});
+		checkpoints.erase(first, last);
+	}
+	auto last = std::upper_bound(children.begin(), children.end(), end, [](std::size_t end, const Node& child) {
+		return end < child.start_pos;
+	});
+	auto first = std::lower_bound(children.begin(), last, end, [](const Node& child, std::size_t end) {
+		return child.start_max_pos < end;
+	});
+	last = children.erase(first, last);
+	// only the last child that starts before end can have looked at it
+	if (last != children.begin()) {
+		(last - 1)->invalidate_end(end);
+	}
+}
+void Cache::Node::raise_max_pos(std::size_t pos, std::size_t max_pos) {
+	for (auto iter = checkpoints.rbegin(); iter != checkpoints.rend() && iter->max_pos >= pos; ++iter) {
+		iter->max_pos = std::max(iter->max_pos, max_pos);
+	}
+	// the last child that started before pos can still have looked at it
+	for (auto iter = children.rbegin(); iter != children.rend(); ++iter) {
+		iter->raise_max_pos(pos, max_pos);
+		if (iter->start_max_pos < pos) {
+			break;
+		}
+		iter->start_max_pos = std::max(iter->start_max_pos, max_pos);
+	}
+}
+void Cache::Node::shift(std::size_t deleted, std::size_t inserted) {
+	start_pos = start_pos - deleted + inserted;
+	start_max_pos = start_max_pos - deleted + inserted;
+	if (end_delimiter) {
+		end_pos = end_pos - deleted + inserted;
+	}
+	for (Checkpoint& checkpoint: checkpoints) {
+		checkpoint.pos = checkpoint.pos - deleted + inserted;
+		checkpoint.max_pos = checkpoint.max_pos - deleted + inserted;
+	}
+	for (Node& child: children) {
+		child.shift(deleted, inserted);
+	}
+}
+std::size_t Cache::Node::get_size() const {
+	std::size_t size = checkpoints.capacity() * sizeof(Checkpoint) + children.capacity() * sizeof(Node);
+	for (const Node& child: children) {
+		size += child.get_size();
+	}
+	return size;
+}
+void Cache::Node::thin() {
+	if (checkpoints.size() > 1) {
+		// the last checkpoint is kept because it is where parsing continues
+		std::size_t j = 0;
+		for (std::size_t i = checkpoints.size() % 2 == 0 ? 1 : 0; i < checkpoints.size(); i += 2) {
+			checkpoints[j++] = checkpoints[i];
+		}
+		checkpoints.resize(j);
+	}
+	checkpoints.shrink_to_fit();
+	for (Node& child: children) {
+		child.thin();
+	}
+	children.shrink_to_fit();
+}
+void Cache::Node::prune(std::size_t limit, std::size_t distance) {
+	// a child is finished once a checkpoint of this node comes after its start
+	const std::size_t last_checkpoint = get_last_checkpoint();
+	children.erase(std::remove_if(children.begin(), children.end(), [&](const Node& child) {
+		return child.start_pos < limit && child.start_pos < last_checkpoint;
+	}), children.end());
+	for (Node& child: children) {
+		child.prune(limit, distance);
+	}
+	std::size_t j = 0;
+	for (std::size_t i = 0; i < checkpoints.size(); ++i) {
+		const Checkpoint& checkpoint = checkpoints[i];
+		// the last checkpoint is kept because it is where parsing continues
+		const bool keep = checkpoint.pos >= limit || i + 1 == checkpoints.size() || j == 0 || checkpoint.pos / distance != checkpoints[j - 1].pos / distance;
+		if (keep) {
+			checkpoints[j++] = checkpoint;
+		}
+	}
+	checkpoints.resize(j);
+}
+Cache::Cache(std::pmr::memory_resource* resource): root_node(0, 0, resource), tail(0, 0, resource), tail_first(0), tail_id(0), resume_pos(-1), line_starts(1, 0, resource), lines_end(0), lines_complete(false) {}
 Cache::Node* Cache::get_root_node() {
 	return &root_node;
 }
 void Cache::invalidate(std::size_t pos) {
 	root_node.invalidate(pos);
+	invalidate_lines(pos);
+	clear_tail();
 }
-
-class Spans {
-	std::vector<Span>& spans;
-	std::size_t start;
-	int style;
-	void emit_span(std::size_t end, const Range& window) {
-		if (start == end) {
-			return;
+void Cache::invalidate_end(std::size_t end) {
+	root_node.invalidate_end(end);
+}
+std::size_t Cache::get_size() const {
+	return sizeof(Cache) + root_node.get_size() + tail.get_size() + line_starts.capacity() * sizeof(std::size_t);
+}
+void Cache::thin() {
+	root_node.thin();
+	tail.thin();
+	tail_first = 0;
+}
+std::size_t Cache::get_restart_pos(std::size_t pos, std::size_t end) const {
+	// the outermost repetition of every language is the first child of the root node
+	if (root_node.children.empty()) {
+		return 0;
+	}
+	const Node& node = root_node.children.front();
+	for (auto iter = node.checkpoints.rbegin(); iter != node.checkpoints.rend(); ++iter) {
+		// checkpoints that looked at end are invalidated once the input changes there
+		if (iter->pos <= pos && iter->max_pos < end) {
+			return iter->pos;
 		}
-		if (end <= window.start || start >= window.end) {
-			return;
+	}
+	return node.start_pos;
+}
+void Cache::prune(std::size_t limit, std::size_t distance) {
+	root_node.prune(limit, distance);
+}
+void Cache::restart(std::size_t pos) {
+	root_node.checkpoints.clear();
+	root_node.children.clear();
+	clear_tail();
+	// the outermost repetition continues at pos
+	root_node.add_child(0, 0)->add_checkpoint(pos, pos);
+}
+void Cache::edit(const Input* input, std::size_t pos, std::size_t deleted, std::size_t inserted) {
+	invalidate_lines(pos);
+	// the nodes from the root to the innermost embedded region that contains the edit
+	std::vector<Node*> path;
+	std::size_t region_depth = 0;
+	for (Node* node = &root_node; ; ) {
+		path.push_back(node);
+		if (node->end_delimiter && node->start_max_pos < pos && pos + deleted <= node->end_pos) {
+			region_depth = path.size();
 		}
-		if (style == Style::DEFAULT) {
-			return;
+		auto iter = std::lower_bound(node->children.begin(), node->children.end(), pos, [](const Node& child, std::size_t pos) {
+			return child.start_pos < pos;
+		});
+		if (iter == node->children.begin()) {
+			break;
 		}
-		if (spans.size() > 0) {
-			Span& last_span = spans.back();
-			if (last_span.end == start && last_span.style == style) {
-				last_span.end = std::min(end, window.end);
-				return;
+		node = &*(iter - 1);
+	}
+	path.resize(region_depth);
+	// the edit could have moved the end of the region or of a surrounding region
+	for (Node* node: path) {
+		if (node->end_delimiter) {
+			std::pmr::vector<Span> spans;
+			ParseContext context(input, spans, 0, 0);
+			context.set_position(node->start_pos);
+			if (find_end_delimiter(context, node->end_delimiter) != node->end_pos - deleted + inserted) {
+				region_depth = 0;
+				break;
 			}
 		}
-		spans.emplace_back(std::max(start, window.start), std::min(end, window.end), style);
 	}
-public:
-	Spans(std::vector<Span>& spans): spans(spans), start(0), style(Style::DEFAULT) {}
-	int change_style(std::size_t pos, int new_style, const Range& window) {
-		emit_span(pos, window);
-		start = pos;
-		const int old_style = style;
-		style = new_style;
-		return old_style;
-	}
-	struct SavePoint {
-		std::size_t spans_size;
-		std::size_t start;
-		int style;
-	};
-	SavePoint save() const {
-		return {spans.size(), start, style};
+	if (region_depth == 0) {
+		edit_tail(pos, deleted, inserted, true);
+		root_node.invalidate(pos);
+		return;
 	}
-	void restore(const SavePoint& save_point) {
-		spans.resize(save_point.spans_size);
-		start = save_point.start;
-		style = save_point.style;
+	Node* region = path.back();
+	const std::size_t end_pos = region->end_pos;
+	region->invalidate(pos);
+	region->end_pos = end_pos - deleted + inserted;
+	if (!edit_tail(pos, deleted, inserted, false)) {
+		// the parse continues behind the region as before
+		resume_pos = region->end_pos;
 	}
-};
-
-class Scope {
-	Scope* parent_scope;
-	std::size_t pos;
-	std::size_t max_pos;
-	Cache::Node* node;
-	std::size_t get_last_checkpoint() const {
-		return node ? node->get_last_checkpoint() : pos;
+	// everything behind the region only depends on where it ends
+	for (std::size_t i = region_depth - 1; i-- > 0;) {
+		Node* node = path[i];
+		node->checkpoints.erase(std::remove_if(node->checkpoints.begin(), node->checkpoints.end(), [&](const Checkpoint& checkpoint) {
+			return checkpoint.pos < end_pos && checkpoint.max_pos >= pos;
+		}), node->checkpoints.end());
+		for (Checkpoint& checkpoint: node->checkpoints) {
+			if (checkpoint.pos >= end_pos) {
+				checkpoint.pos = checkpoint.pos - deleted + inserted;
+				checkpoint.max_pos = checkpoint.max_pos - deleted + inserted;
+			}
+		}
+		for (Node& child: node->children) {
+			if (child.start_pos > path[i + 1]->start_pos) {
+				child.shift(deleted, inserted);
+			}
+		}
+		if (node->end_delimiter) {
+			node->end_pos = node->end_pos - deleted + inserted;
+		}
 	}
-	Cache::Node* find_child(std::size_t pos) const {
-		return node ? node->find_child(pos) : nullptr;
+}
+std::size_t Cache::get_tail_pos() const {
+	return tail_first < tail.checkpoints.size() ? tail.checkpoints[tail_first].pos : -1;
+}
+bool Cache::resume_tail(Node* node, std::size_t pos, std::size_t max_pos) {
+	auto iter = std::lower_bound(tail.checkpoints.begin() + tail_first, tail.checkpoints.end(), pos, [](const Checkpoint& checkpoint, std::size_t pos) {
+		return checkpoint.pos < pos;
+	});
+	tail_first = iter - tail.checkpoints.begin();
+	if (iter == tail.checkpoints.end() || iter->pos != pos) {
+		return false;
 	}
-	Cache::Node* ensure_node() {
-		if (node == nullptr) {
-			node = parent_scope->ensure_node()->add_child(pos, max_pos);
-		}
-		return node;
+	// the checkpoints and children of the tail also depend on what this parse looked at before pos
+	for (auto i = iter; i != tail.checkpoints.end() && i->max_pos < max_pos; ++i) {
+		i->max_pos = max_pos;
 	}
-public:
-	Scope(Cache::Node* node): parent_scope(nullptr), pos(0), max_pos(0), node(node) {}
-	Scope(Scope* parent_scope, std::size_t pos, std::size_t max_pos): parent_scope(parent_scope), pos(pos), max_pos(max_pos), node(parent_scope->find_child(pos)) {}
-	Scope* get_parent_scope() const {
-		return parent_scope;
+	auto child = std::lower_bound(tail.children.begin(), tail.children.end(), pos, [](const Node& child, std::size_t pos) {
+		return child.start_pos < pos;
+	});
+	for (auto i = child; i != tail.children.end() && i->start_max_pos < max_pos; ++i) {
+		i->start_max_pos = max_pos;
 	}
-	void add_checkpoint(std::size_t pos, std::size_t max_pos) {
-		if (pos >= get_last_checkpoint() + 16) {
-			ensure_node()->add_checkpoint(pos, max_pos);
+	node->checkpoints.erase(std::lower_bound(node->checkpoints.begin(), node->checkpoints.end(), pos, [](const Checkpoint& checkpoint, std::size_t pos) {
+		return checkpoint.pos < pos;
+	}), node->checkpoints.end());
+	node->children.erase(std::lower_bound(node->children.begin(), node->children.end(), pos, [](const Node& child, std::size_t pos) {
+		return child.start_pos < pos;
+	}), node->children.end());
+	node->checkpoints.insert(node->checkpoints.end(), iter, tail.checkpoints.end());
+	node->children.insert(node->children.end(), std::make_move_iterator(child), std::make_move_iterator(tail.children.end()));
+	tail.checkpoints.clear();
+	tail.children.clear();
+	tail_first = 0;
+	resume_pos = pos;
+	return true;
+}
+std::size_t Cache::get_tail_id() const {
+	return tail_id;
+}
+std::size_t Cache::get_resume_pos() const {
+	return resume_pos;
+}
+void Cache::clear_tail() {
+	tail.checkpoints.clear();
+	tail.children.clear();
+	tail_first = 0;
+	++tail_id;
+	resume_pos = -1;
+}
+// a tail that parsing has not continued with yet is kept, otherwise the checkpoints of the outermost repetition behind the edit become the new tail
+// the checkpoints that parsing passed are kept as well, after the edit it can reach them
+// returns whether the tail was kept
+bool Cache::edit_tail(std::size_t pos, std::size_t deleted, std::size_t inserted, bool keep_checkpoints) {
+	const bool kept = !tail.checkpoints.empty();
+	if (!kept) {
+		clear_tail();
+		if (keep_checkpoints && !root_node.children.empty()) {
+			Node& node = root_node.children.front();
+			tail.checkpoints.assign(std::lower_bound(node.checkpoints.begin(), node.checkpoints.end(), pos + deleted, [](const Checkpoint& checkpoint, std::size_t pos) {
+				return checkpoint.pos < pos;
+			}), node.checkpoints.end());
+			auto child = std::lower_bound(node.children.begin(), node.children.end(), pos + deleted, [](const Node& child, std::size_t pos) {
+				return child.start_pos < pos;
+			});
+			// the children are removed from node by the invalidation that follows
+			tail.children.assign(std::make_move_iterator(child), std::make_move_iterator(node.children.end()));
 		}
 	}
-	Cache::Checkpoint find_checkpoint(std::size_t pos) {
-		if (node) {
-			const Cache::Checkpoint* checkpoint = node->find_checkpoint(pos);
-			if (checkpoint) {
-				return *checkpoint;
+	// only the checkpoints behind the edit still describe the input after them
+	tail.checkpoints.erase(tail.checkpoints.begin(), std::lower_bound(tail.checkpoints.begin(), tail.checkpoints.end(), pos + deleted, [](const Checkpoint& checkpoint, std::size_t pos) {
+		return checkpoint.pos < pos;
+	}));
+	tail_first = 0;
+	const std::size_t first = tail.checkpoints.empty() ? -1 : tail.checkpoints.front().pos;
+	tail.children.erase(tail.children.begin(), std::lower_bound(tail.children.begin(), tail.children.end(), first, [](const Node& child, std::size_t pos) {
+		return child.start_pos < pos;
+	}));
+	for (Checkpoint& checkpoint: tail.checkpoints) {
+		checkpoint.pos = checkpoint.pos - deleted + inserted;
+		checkpoint.max_pos = checkpoint.max_pos - deleted + inserted;
+	}
+	for (Node& child: tail.children) {
+		child.shift(deleted, inserted);
+	}
+	return kept;
+}
+void Cache::index_lines(const Input* input, std::size_t line) {
+	auto chunk_pair = input->get_chunk(lines_end);
+	Input::Chunk chunk = chunk_pair.first;
+	std::size_t offset = chunk_pair.second;
+	while (line_starts.size() <= line) {
+		if (lines_end - offset >= chunk.size) {
+			if (chunk.size == 0) {
+				lines_complete = true;
+				return;
 			}
+			offset += chunk.size;
+			chunk = input->get_next_chunk(chunk.chunk);
+			continue;
+		}
+		const char* begin = chunk.data + (lines_end - offset);
+		const char* newline = static_cast<const char*>(std::memchr(begin, '\n', chunk.size - (lines_end - offset)));
+		if (newline) {
+			lines_end = offset + (newline - chunk.data) + 1;
+			line_starts.push_back(lines_end);
+		}
+		else {
+			lines_end = offset + chunk.size;
 		}
-		return {this->pos, this->max_pos};
 	}
-};
-
-enum class Result: unsigned char {
-	FAILURE,
-	SUCCESS,
-	PARTIAL_SUCCESS
-};
+}
+void Cache::invalidate_lines(std::size_t pos) {
+	// a line that starts after pos could have lost its newline
+	while (line_starts.back() > pos) {
+		line_starts.pop_back();
+	}
+	lines_end = std::min(lines_end, pos);
+	lines_complete = false;
+}
+std::size_t Cache::get_line_start(const Input* input, std::size_t line) {
+	if (line >= line_starts.size() && !lines_complete) {
+		index_lines(input, line);
+	}
+	return line < line_starts.size() ? line_starts[line] : -1;
+}
+std::size_t Cache::get_line_end(const Input* input, std::size_t line) {
+	const std::size_t next_start = get_line_start(input, line + 1);
+	if (next_start != static_cast<std::size_t>(-1)) {
+		return next_start;
+	}
+	// the last line ends at the end of the input
+	return line < line_starts.size() ? lines_end : -1;
+}
+std::size_t Cache::get_line(const Input* input, std::size_t pos) {
+	while (line_starts.back() <= pos && !lines_complete) {
+		index_lines(input, line_starts.size());
+	}
+	return std::upper_bound(line_starts.begin(), line_starts.end(), pos) - line_starts.begin() - 1;
+}
 
-class ParseContext {
-	InputAdapter input;
-	Range window;
-	std::size_t max_pos;
-	Spans spans;
-	Scope* current_scope;
-public:
-	ParseContext(const Input* input, std::vector<Span>& spans, std::size_t window_start, std::size_t window_end): input(input), window(window_start, window_end), max_pos(0), spans(spans), current_scope(nullptr) {}
-	char get() const {
-		return input.get();
-	}
-	void advance() {
-		input.advance();
-	}
-	int change_style(int new_style) {
-		return spans.change_style(input.get_position(), new_style, window);
-	}
-	bool add_checkpoint() {
-		current_scope->add_checkpoint(input.get_position(), std::max(max_pos, input.get_position()));
-		return input.get_position() >= window.end;
-	}
-	void skip_to_checkpoint() {
-		const auto checkpoint = current_scope->find_checkpoint(window.start);
-		input.set_position(checkpoint.pos);
-		max_pos = checkpoint.max_pos;
-	}
-	template <class F> void add_root_scope(Cache& cache, F f) {
-		Scope root_scope(cache.get_root_node());
-		current_scope = &root_scope;
-		f();
-		current_scope = nullptr;
-	}
-	template <class F> Result add_scope(F f) {
-		Scope scope(current_scope, input.get_position(), std::max(max_pos, input.get_position()));
-		current_scope = &scope;
-		const Result result = f();
-		current_scope = scope.get_parent_scope();
-		return result;
+// calls f with the parts of the range that survive the edit, moved to their new positions
+template <class F> static void map_range(const Range& range, std::size_t pos, std::size_t deleted, std::size_t inserted, F f) {
+	if (range.start < pos) {
+		f(range.start, std::min(range.end, pos));
+	}
+	if (range.end > pos + deleted) {
+		f(std::max(range.start, pos + deleted) - deleted + inserted, range.end - deleted + inserted);
+	}
+}
+void ChangeTracker::edit(std::size_t pos, std::size_t deleted, std::size_t inserted) {
+	std::vector<Span> new_spans;
+	for (const Span& span: spans) {
+		map_range(span, pos, deleted, inserted, [&](std::size_t start, std::size_t end) {
+			new_spans.emplace_back(start, end, span.style);
+		});
+	}
+	spans = std::move(new_spans);
+	std::vector<Range> new_known_ranges;
+	for (const Range& range: known_ranges) {
+		map_range(range, pos, deleted, inserted, [&](std::size_t start, std::size_t end) {
+			new_known_ranges.emplace_back(start, end);
+		});
+	}
+	known_ranges = std::move(new_known_ranges);
+}
+std::vector<Range> ChangeTracker::update(const std::vector<Span>& new_spans, std::size_t window_start, std::size_t window_end) {
+	std::vector<std::size_t> boundaries = {window_start, window_end};
+	for (const Span& span: spans) {
+		boundaries.push_back(span.start);
+		boundaries.push_back(span.end);
+	}
+	for (const Span& span: new_spans) {
+		boundaries.push_back(span.start);
+		boundaries.push_back(span.end);
+	}
+	for (const Range& range: known_ranges) {
+		boundaries.push_back(range.start);
+		boundaries.push_back(range.end);
+	}
+	std::sort(boundaries.begin(), boundaries.end());
+	boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+	std::vector<Range> changed_ranges;
+	auto old_span = spans.begin();
+	auto new_span = new_spans.begin();
+	auto known_range = known_ranges.begin();
+	for (std::size_t i = 0; i + 1 < boundaries.size(); ++i) {
+		const std::size_t start = boundaries[i];
+		const std::size_t end = boundaries[i + 1];
+		if (start < window_start || end > window_end) {
+			continue;
+		}
+		while (old_span != spans.end() && old_span->end <= start) {
+			++old_span;
+		}
+		while (new_span != new_spans.end() && new_span->end <= start) {
+			++new_span;
+		}
+		while (known_range != known_ranges.end() && known_range->end <= start) {
+			++known_range;
+		}
+		const bool known = known_range != known_ranges.end() && known_range->start <= start;
+		const int old_style = old_span != spans.end() && old_span->start <= start ? old_span->style : Style::DEFAULT;
+		const int new_style = new_span != new_spans.end() && new_span->start <= start ? new_span->style : Style::DEFAULT;
+		if (!known || old_style != new_style) {
+			if (!changed_ranges.empty() && changed_ranges.back().end == start) {
+				changed_ranges.back().end = end;
+			}
+			else {
+				changed_ranges.emplace_back(start, end);
+			}
+		}
 	}
-	struct SavePoint {
-		std::size_t pos;
-		Spans::SavePoint spans;
+	spans = new_spans;
+	known_ranges.assign(1, Range(window_start, window_end));
+	return changed_ranges;
+}
+
+static std::vector<std::uint32_t> encode_semantic_tokens(const Input* input, const std::vector<Span>& spans) {
+	std::vector<std::uint32_t> data;
+	InputAdapter reader(input);
+	std::size_t line = 0;
+	std::size_t column = 0;
+	std::size_t last_line = 0;
+	std::size_t last_column = 0;
+	auto add_token = [&](std::size_t token_line, std::size_t token_column, int type) {
+		if (column == token_column) {
+			return;
+		}
+		data.push_back(token_line - last_line);
+		data.push_back(token_line == last_line ? token_column - last_column : token_column);
+		data.push_back(column - token_column);
+		data.push_back(type);
+		data.push_back(0);
+		last_line = token_line;
+		last_column = token_column;
 	};
-	SavePoint save() const {
-		return {input.get_position(), spans.save()};
+	// moves the reader over one byte, UTF-8 lead bytes of 4 byte sequences are two UTF-16 code units
+	auto advance = [&]() {
+		const unsigned char c = reader.get();
+		if (c == '\n') {
+			++line;
+			column = 0;
+		}
+		else {
+			column += ((c & 0xC0) != 0x80) + (c >= 0xF0);
+		}
+		reader.advance();
+	};
+	const std::size_t token_types = sizeof(SemanticTokens::TOKEN_TYPES) / sizeof(SemanticTokens::TOKEN_TYPES[0]);
+	for (const Span& span: spans) {
+		const int type = span.style - Style::COMMENT;
+		if (type < 0 || static_cast<std::size_t>(type) >= token_types) {
+			continue;
+		}
+		while (reader.get_position() < span.start) {
+			advance();
+		}
+		std::size_t token_line = line;
+		std::size_t token_column = column;
+		while (reader.get_position() < span.end) {
+			if (reader.get() == '\n') {
+				add_token(token_line, token_column, type);
+				advance();
+				token_line = line;
+				token_column = column;
+			}
+			else {
+				advance();
+			}
+		}
+		add_token(token_line, token_column, type);
+	}
+	return data;
+}
+const std::vector<std::uint32_t>& SemanticTokens::full(const Input* input, const std::vector<Span>& spans) {
+	data = encode_semantic_tokens(input, spans);
+	++result_id;
+	return data;
+}
+std::vector<SemanticTokens::Edit> SemanticTokens::delta(const Input* input, const std::vector<Span>& spans) {
+	std::vector<std::uint32_t> new_data = encode_semantic_tokens(input, spans);
+	// tokens are encoded relative to the previous token, so an edit usually only changes a single run of integers
+	std::size_t prefix = 0;
+	while (prefix < data.size() && prefix < new_data.size() && data[prefix] == new_data[prefix]) {
+		++prefix;
 	}
-	void restore(const SavePoint& save_point) {
-		max_pos = std::max(max_pos, input.get_position());
-		input.set_position(save_point.pos);
-		spans.restore(save_point.spans);
+	std::size_t suffix = 0;
+	while (suffix < data.size() - prefix && suffix < new_data.size() - prefix && data[data.size() - 1 - suffix] == new_data[new_data.size() - 1 - suffix]) {
+		++suffix;
 	}
-};
+	std::vector<Edit> edits;
+	if (prefix + suffix < data.size() || prefix + suffix < new_data.size()) {
+		edits.push_back({prefix, data.size() - prefix - suffix, std::vector<std::uint32_t>(new_data.begin() + prefix, new_data.end() - suffix)});
+	}
+	data = std::move(new_data);
+	++result_id;
+	return edits;
+}
 
-template <class F> class Char {
-	F f;
-public:
-	static constexpr bool always_succeeds() {
+static char get_closing_bracket(char c) {
+	switch (c) {
+	case '(':
+		return ')';
+	case '[':
+		return ']';
+	case '{':
+		return '}';
+	default:
+		return '\0';
+	}
+}
+static bool is_bracket(char c) {
+	return c == '(' || c == ')' || c == '[' || c == ']' || c == '{' || c == '}';
+}
+template <class F> void BracketIndex::update(const Language* language, const Input* input, Cache& cache, std::size_t end, F f) {
+	// the steps keep parsing from going far past the position where the cache continues with its tail
+	for (std::size_t step = 1024; this->end < end; step *= 2) {
+		const std::size_t step_end = this->end >= tail_end ? end : this->end + std::min(step, end - this->end);
+		const std::vector<Span> spans = prism::highlight(language, input, cache, this->end, step_end);
+		add(input, cache, spans, step_end);
+		if (this->end < step_end) {
+			// the input ended
+			f(spans, -1);
+			break;
+		}
+		f(spans, resume(input, cache) ? step_end : -1);
+	}
+}
+void BracketIndex::update(const Language* language, const Input* input, Cache& cache, std::size_t end) {
+	update(language, input, cache, end, [](const std::vector<Span>&, std::size_t) {});
+}
+void BracketIndex::add(const Input* input, Cache& cache, const std::vector<Span>& spans, std::size_t end) {
+	auto span = spans.begin();
+	InputAdapter reader(input);
+	std::size_t pos = this->end;
+	// the line of the first bracket is looked up, the lines of the others are counted from there
+	std::size_t newlines = 0;
+	std::size_t first_line = -1;
+	reader.set_position(pos);
+	while (pos < end) {
+		const StringView chunk = reader.get_chunk();
+		if (chunk.size() == 0) {
+			break;
+		}
+		const std::size_t size = std::min(chunk.size(), end - pos);
+		for (std::size_t i = 0; i < size; ++i) {
+			const char c = chunk[i];
+			if (!is_bracket(c)) {
+				newlines += c == '\n';
+				continue;
+			}
+			while (span != spans.end() && span->end <= pos + i) {
+				++span;
+			}
+			if (span != spans.end() && span->start <= pos + i && (span->style == Style::COMMENT || span->style == Style::STRING || span->style == Style::ESCAPE)) {
+				continue;
+			}
+			if (first_line == static_cast<std::size_t>(-1)) {
+				first_line = cache.get_line(input, pos + i) - newlines;
+			}
+			add_bracket(pos + i, first_line + newlines, c);
+		}
+		pos += size;
+		reader.set_position(pos);
+	}
+	this->end = pos;
+}
+void BracketIndex::add_bracket(std::size_t pos, std::size_t line, char c) {
+	const std::size_t index = brackets.size();
+	const std::size_t top = open_brackets.empty() ? -1 : open_brackets.back();
+	if (get_closing_bracket(c)) {
+		brackets.push_back({pos, line, c, open_brackets.size(), static_cast<std::size_t>(-1), top});
+		open_brackets.push_back(index);
+	}
+	else if (top != static_cast<std::size_t>(-1) && get_closing_bracket(brackets[top].c) == c) {
+		open_brackets.pop_back();
+		brackets[top].match = index;
+		brackets.push_back({pos, line, c, open_brackets.size(), top, brackets[top].parent});
+	}
+	else {
+		// a closing bracket that does not match the innermost opening bracket closes nothing
+		brackets.push_back({pos, line, c, open_brackets.size(), static_cast<std::size_t>(-1), top});
+	}
+}
+void BracketIndex::edit(const Cache& cache, std::size_t pos, std::size_t deleted, std::size_t inserted) {
+	if (cache.get_tail_id() != tail_id) {
+		// the cache made the checkpoints behind this edit its tail, the brackets behind it come from the same parse
+		tail.assign(std::lower_bound(brackets.begin(), brackets.end(), pos + deleted, [](const Bracket& bracket, std::size_t pos) {
+			return bracket.pos < pos;
+		}), brackets.end());
+		tail_end = end;
+		tail_id = cache.get_tail_id();
+	}
+	if (tail_end > pos + deleted) {
+		tail.erase(tail.begin(), std::lower_bound(tail.begin(), tail.end(), pos + deleted, [](const Bracket& bracket, std::size_t pos) {
+			return bracket.pos < pos;
+		}));
+		// the lines are corrected once the tail is reused
+		for (Bracket& bracket: tail) {
+			bracket.pos = bracket.pos - deleted + inserted;
+		}
+		tail_end = tail_end - deleted + inserted;
+	}
+	else {
+		tail.clear();
+		tail_end = 0;
+	}
+	truncate(cache, pos);
+}
+void BracketIndex::invalidate(const Cache& cache, std::size_t pos) {
+	tail.clear();
+	tail_end = 0;
+	truncate(cache, pos);
+}
+void BracketIndex::truncate(const Cache& cache, std::size_t pos) {
+	// the spans before the last outermost checkpoint that did not look at pos stay the same
+	const std::size_t restart_pos = std::min(pos, cache.get_restart_pos(pos, pos));
+	if (restart_pos >= end) {
+		return;
+	}
+	end = restart_pos;
+	brackets.erase(std::lower_bound(brackets.begin(), brackets.end(), restart_pos, [](const Bracket& bracket, std::size_t pos) {
+		return bracket.pos < pos;
+	}), brackets.end());
+	// the opening brackets that enclose the new end are open again
+	open_brackets.clear();
+	std::size_t i = brackets.empty() ? -1 : get_closing_bracket(brackets.back().c) ? brackets.size() - 1 : brackets.back().parent;
+	for (; i != static_cast<std::size_t>(-1); i = brackets[i].parent) {
+		brackets[i].match = -1;
+		open_brackets.push_back(i);
+	}
+	std::reverse(open_brackets.begin(), open_brackets.end());
+}
+bool BracketIndex::resume(const Input* input, Cache& cache) {
+	if (cache.get_tail_id() != tail_id) {
+		tail.clear();
+		tail_end = 0;
 		return false;
 	}
-	constexpr Char(F f): f(f) {}
-	template <bool can_checkpoint> Result parse(ParseContext& context) const {
-		if (!f(context.get())) {
-			return Result::FAILURE;
+	// a tail that was passed is kept for the next edit as long as the cache keeps its tail
+	if (end >= tail_end || cache.get_resume_pos() > end) {
+		return false;
+	}
+	// the spans from end on are the same as before the edits, so are the brackets, only their lines, depths and matches can differ
+	auto iter = std::lower_bound(tail.begin(), tail.end(), end, [](const Bracket& bracket, std::size_t pos) {
+		return bracket.pos < pos;
+	});
+	if (iter != tail.end()) {
+		const std::size_t line_delta = cache.get_line(input, iter->pos) - iter->line;
+		for (; iter != tail.end(); ++iter) {
+			add_bracket(iter->pos, iter->line + line_delta, iter->c);
 		}
-		context.advance();
-		return Result::SUCCESS;
 	}
-};
+	end = tail_end;
+	tail.clear();
+	tail_end = 0;
+	return true;
+}
+const BracketIndex::Bracket* BracketIndex::find(std::size_t pos) const {
+	auto iter = std::lower_bound(brackets.begin(), brackets.end(), pos, [](const Bracket& bracket, std::size_t pos) {
+		return bracket.pos < pos;
+	});
+	if (iter != brackets.end() && iter->pos == pos) {
+		return &*iter;
+	}
+	return nullptr;
+}
+std::size_t BracketIndex::find_match(std::size_t pos) const {
+	const Bracket* bracket = find(pos);
+	if (bracket == nullptr || bracket->match == static_cast<std::size_t>(-1)) {
+		return -1;
+	}
+	return brackets[bracket->match].pos;
+}
 
-class String {
-	const char* string;
-public:
-	static constexpr bool always_succeeds() {
+void FoldingIndex::update(const Language* language, const Input* input, Cache& cache, std::size_t end) {
+	brackets.update(language, input, cache, end, [&](const std::vector<Span>& spans, std::size_t resume_pos) {
+		add_comments(input, cache, spans);
+		if (resume_pos != static_cast<std::size_t>(-1)) {
+			resume(input, cache, resume_pos);
+		}
+	});
+}
+bool FoldingIndex::continues_block(const Input* input, std::size_t pos) const {
+	if (comments.empty()) {
 		return false;
 	}
-	constexpr String(const char* string): string(string) {}
-	template <bool can_checkpoint> Result parse(ParseContext& context) const {
-		if (*string == '\0') {
-			return Result::SUCCESS;
+	InputAdapter reader(input);
+	std::size_t newlines = 0;
+	for (reader.set_position(comments.back().end); reader.get_position() < pos; reader.advance()) {
+		const char c = reader.get();
+		newlines += c == '\n';
+		if ((c != ' ' && c != '\t' && c != '\r' && c != '\n') || newlines > 1) {
+			return false;
 		}
-		if (context.get() != *string) {
-			return Result::FAILURE;
+	}
+	return true;
+}
+void FoldingIndex::add_comments(const Input* input, Cache& cache, const std::vector<Span>& spans) {
+	for (const Span& span: spans) {
+		if (span.style != Style::COMMENT) {
+			continue;
 		}
-		const auto save_point = context.save();
-		context.advance();
-		for (const char* s = string + 1; *s != '\0'; ++s) {
-			if (context.get() != *s) {
-				context.restore(save_point);
-				return Result::FAILURE;
+		if (!comments.empty() && comments.back().end == span.start) {
+			// a comment that was highlighted in two steps
+			comments.back().end = span.end;
+			comments.back().end_line = cache.get_line(input, span.end - 1);
+			continue;
+		}
+		comments.push_back({span.start, span.end, cache.get_line(input, span.start), cache.get_line(input, span.end - 1), continues_block(input, span.start)});
+	}
+}
+void FoldingIndex::resume(const Input* input, Cache& cache, std::size_t pos) {
+	// the comments from pos on are the same as before the edits
+	auto iter = std::lower_bound(tail.begin(), tail.end(), pos, [](const Comment& comment, std::size_t pos) {
+		return comment.end <= pos;
+	});
+	if (iter != tail.end()) {
+		const std::size_t line_delta = cache.get_line(input, iter->end - 1) - iter->end_line;
+		if (iter->start < pos) {
+			// the part of the comment before pos was added from the spans
+			if (!comments.empty() && comments.back().end == pos) {
+				comments.back().end = iter->end;
 			}
-			context.advance();
+			else {
+				comments.push_back({pos, iter->end, cache.get_line(input, pos), 0, continues_block(input, pos)});
+			}
+			comments.back().end_line = iter->end_line + line_delta;
+			++iter;
+		}
+		// whether the first comment continues a block depends on the comments before it
+		bool first = true;
+		for (; iter != tail.end(); ++iter) {
+			comments.push_back({iter->start, iter->end, iter->start_line + line_delta, iter->end_line + line_delta, first ? continues_block(input, iter->start) : iter->continues_block});
+			first = false;
 		}
-		return Result::SUCCESS;
 	}
-};
+	tail.clear();
+}
+void FoldingIndex::edit(const Cache& cache, std::size_t pos, std::size_t deleted, std::size_t inserted) {
+	if (cache.get_tail_id() != brackets.tail_id) {
+		tail.assign(std::lower_bound(comments.begin(), comments.end(), pos + deleted, [](const Comment& comment, std::size_t pos) {
+			return comment.start < pos;
+		}), comments.end());
+	}
+	tail.erase(tail.begin(), std::lower_bound(tail.begin(), tail.end(), pos + deleted, [](const Comment& comment, std::size_t pos) {
+		return comment.start < pos;
+	}));
+	for (Comment& comment: tail) {
+		comment.start = comment.start - deleted + inserted;
+		comment.end = comment.end - deleted + inserted;
+	}
+	brackets.edit(cache, pos, deleted, inserted);
+	truncate(cache);
+}
+void FoldingIndex::invalidate(const Cache& cache, std::size_t pos) {
+	tail.clear();
+	brackets.invalidate(cache, pos);
+	truncate(cache);
+}
+void FoldingIndex::truncate(const Cache& cache) {
+	// a comment that reaches past the end is indexed again from its start
+	while (!comments.empty() && comments.back().end > brackets.get_end()) {
+		const std::size_t start = comments.back().start;
+		comments.pop_back();
+		brackets.truncate(cache, start);
+	}
+}
 
-template <class... T> class Sequence;
-template <> class Sequence<> {
-public:
-	static constexpr bool always_succeeds() {
-		return true;
+CacheManager::CacheManager(std::size_t budget): budget(budget), size(0) {}
+CacheManager::Entry& CacheManager::use(std::uint64_t document) {
+	auto iter = entries.find(document);
+	if (iter == entries.end()) {
+		lru.push_back(document);
+		Entry& entry = entries[document];
+		entry.size = 0;
+		entry.thinned = false;
+		entry.lru_position = std::prev(lru.end());
+		update_size(entry);
+		return entry;
 	}
-	constexpr Sequence() {}
-	template <bool can_checkpoint> Result parse(ParseContext& context) const {
-		return Result::SUCCESS;
+	lru.splice(lru.end(), lru, iter->second.lru_position);
+	return iter->second;
+}
+void CacheManager::update_size(Entry& entry) {
+	const std::size_t new_size = entry.cache.get_size();
+	size = size - entry.size + new_size;
+	entry.size = new_size;
+}
+void CacheManager::enforce_budget() {
+	for (auto iter = lru.begin(); size > budget && iter != lru.end(); ++iter) {
+		Entry& entry = entries[*iter];
+		if (!entry.thinned) {
+			entry.cache.thin();
+			entry.thinned = true;
+			update_size(entry);
+		}
 	}
-};
-template <class T0, class... T> class Sequence<T0, T...> {
-	T0 t0;
-	Sequence<T...> t;
-public:
-	static constexpr bool always_succeeds() {
-		return T0::always_succeeds() && Sequence<T...>::always_succeeds();
+	// the most recently used cache is not evicted, it is probably about to be used again
+	// an evicted document is removed entirely, even an empty cache counts against the budget
+	while (size > budget && lru.size() > 1) {
+		remove(lru.front());
+	}
+}
+std::vector<Span> CacheManager::highlight(std::uint64_t document, const Language* language, const Input* input, std::size_t window_start, std::size_t window_end) {
+	Entry& entry = use(document);
+	std::vector<Span> spans = prism::highlight(language, input, entry.cache, window_start, window_end);
+	entry.thinned = false;
+	update_size(entry);
+	enforce_budget();
+	return spans;
+}
+void CacheManager::edit(std::uint64_t document, const Input* input, std::size_t pos, std::size_t deleted, std::size_t inserted) {
+	auto iter = entries.find(document);
+	if (iter != entries.end()) {
+		iter->second.cache.edit(input, pos, deleted, inserted);
+		// the checkpoints behind the edit become the tail of the cache, which can make it larger
+		update_size(iter->second);
+		enforce_budget();
+	}
+}
+void CacheManager::remove(std::uint64_t document) {
+	auto iter = entries.find(document);
+	if (iter != entries.end()) {
+		size -= iter->second.size;
+		lru.erase(iter->second.lru_position);
+		entries.erase(iter);
+	}
+}
+void CacheManager::set_budget(std::size_t budget) {
+	this->budget = budget;
+	enforce_budget();
+}
+std::size_t CacheManager::get_size() const {
+	return size;
+}
+
+#ifdef PRISM_PROFILE
+thread_local Profiler profiler;
+#endif
+
+Result parse_code_point(ParseContext& context, UnicodeProperty property) {
+	const unsigned char c = context.get();
+	std::size_t length;
+	char32_t code_point;
+	if (c < 0xC2) {
+		return Result::FAILURE;
+	}
+	else if (c < 0xE0) {
+		length = 2;
+		code_point = c & 0x1F;
+	}
+	else if (c < 0xF0) {
+		length = 3;
+		code_point = c & 0x0F;
+	}
+	else if (c < 0xF5) {
+		length = 4;
+		code_point = c & 0x07;
+	}
+	else {
+		return Result::FAILURE;
 	}
-	constexpr Sequence(T0 t0, T... t): t0(t0), t(t...) {}
-	template <bool can_checkpoint> Result parse(ParseContext& context) const {
-		const auto save_point = context.save();
-		const Result result = t0.template parse<can_checkpoint && Sequence<T...>::always_succeeds()>(context);
+	const auto save_point = context.save<false>();
+	context.advance();
+	for (std::size_t i = 1; i < length; ++i) {
+		const unsigned char continuation = context.get();
+		if ((continuation & 0xC0) != 0x80) {
+			context.restore(save_point);
+			return Result::FAILURE;
+		}
+		code_point = code_point << 6 | (continuation & 0x3F);
+		context.advance();
+	}
+	const bool overlong = (length == 3 && code_point < 0x800) || (length == 4 && code_point < 0x10000);
+	if (overlong || code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF) || !has_property(property, code_point)) {
+		context.restore(save_point);
+		return Result::FAILURE;
+	}
+	return Result::SUCCESS;
+}
+
+template <bool emits_spans> Result Program::execute_sequence(std::uint32_t ip, ParseContext& context) const {
+	const auto save_point = context.save<emits_spans>();
+	const std::uint32_t end = ip + instructions[ip].size;
+	for (std::uint32_t child = ip + 1; child < end; child += instructions[child].size) {
+		const Result result = execute(child, context);
 		if (result != Result::SUCCESS) {
+			if (result == Result::FAILURE && child != ip + 1) {
+				context.restore(save_point);
+			}
 			return result;
 		}
-		{
-			const Result result = t.template parse<can_checkpoint>(context);
+	}
+	return Result::SUCCESS;
+}
+template <bool emits_spans> Result Program::execute_minimum_repetitions(std::uint32_t ip, std::uint32_t child, ParseContext& context) const {
+	const auto save_point = context.save<emits_spans>();
+	for (std::uint32_t i = 0; i < instructions[ip].a; ++i) {
+		const Result result = execute(child, context);
+		if (result != Result::SUCCESS) {
 			if (result == Result::FAILURE) {
 				context.restore(save_point);
 			}
 			return result;
 		}
 	}
-};
-
-template <class... T> class Choice;
-template <> class Choice<> {
-public:
-	static constexpr bool always_succeeds() {
-		return false;
+	return Result::SUCCESS;
+}
+template <bool emits_spans> Result Program::execute_lookahead(std::uint32_t ip, ParseContext& context) const {
+	const auto save_point = context.save<emits_spans>();
+	if (execute(ip + 1, context) == Result::SUCCESS) {
+		context.restore(save_point);
+		return instructions[ip].opcode == Opcode::AND ? Result::SUCCESS : Result::FAILURE;
 	}
-	constexpr Choice() {}
-	template <bool can_checkpoint> Result parse(ParseContext& context) const {
-		return Result::FAILURE;
+	else {
+		return instructions[ip].opcode == Opcode::AND ? Result::FAILURE : Result::SUCCESS;
 	}
-};
-template <class T0, class... T> class Choice<T0, T...> {
-	T0 t0;
-	Choice<T...> t;
-public:
-	static constexpr bool always_succeeds() {
-		return T0::always_succeeds() || Choice<T...>::always_succeeds();
+}
+template <bool can_checkpoint> Result Program::execute_repetitions(std::uint32_t ip, std::uint32_t child, ParseContext& context) const {
+	const std::uint32_t max_repetitions = instructions[ip].b;
+	for (std::uint32_t i = instructions[ip].a; max_repetitions == 0 || i < max_repetitions; ++i) {
+		const Result result = execute(child, context);
+		if (result != Result::SUCCESS) {
+			return result == Result::FAILURE ? Result::SUCCESS : result;
+		}
+		if (can_checkpoint && context.add_checkpoint()) {
+			return Result::PARTIAL_SUCCESS;
+		}
 	}
-	constexpr Choice(T0 t0, T... t): t0(t0), t(t...) {}
-	template <bool can_checkpoint> Result parse(ParseContext& context) const {
-		const Result result = t0.template parse<can_checkpoint>(context);
-		if (result != Result::FAILURE) {
-			return result;
+	return Result::SUCCESS;
+}
+Result Program::execute(std::uint32_t ip, ParseContext& context) const {
+	const Instruction& instruction = instructions[ip];
+	switch (instruction.opcode) {
+	case Opcode::CHAR:
+		if (!test_char_class(instruction.a, context.get())) {
+			return Result::FAILURE;
+		}
+		context.advance();
+		return Result::SUCCESS;
+	case Opcode::UNICODE_CHAR: {
+		const char c = context.get();
+		if (test_char_class(instruction.a, c)) {
+			context.advance();
+			return Result::SUCCESS;
 		}
-		return t.template parse<can_checkpoint>(context);
+		if (static_cast<unsigned char>(c) < 128) {
+			return Result::FAILURE;
+		}
+		return parse_code_point(context, static_cast<UnicodeProperty>(instruction.b));
 	}
-};
-
-template <std::size_t MIN_REPETITIONS, std::size_t MAX_REPETITIONS, class T> class Repetition {
-	T t;
-public:
-	static constexpr bool always_succeeds() {
-		return MIN_REPETITIONS == 0 || T::always_succeeds();
+	case Opcode::STRING: {
+		const char* string = strings[instruction.a];
+		if (*string == '\0') {
+			return Result::SUCCESS;
+		}
+		if (context.get() != *string) {
+			return Result::FAILURE;
+		}
+		const auto save_point = context.save<false>();
+		context.advance();
+		for (const char* s = string + 1; *s != '\0'; ++s) {
+			if (context.get() != *s) {
+				context.restore(save_point);
+				return Result::FAILURE;
+			}
+			context.advance();
+		}
+		return Result::SUCCESS;
 	}
-	constexpr Repetition(T t): t(t) {}
-	template <bool can_checkpoint> Result parse(ParseContext& context) const {
-		if constexpr (MIN_REPETITIONS == 1) {
-			const Result result = t.template parse<can_checkpoint>(context);
+	case Opcode::SEQUENCE:
+		return instruction.emits_spans ? execute_sequence<true>(ip, context) : execute_sequence<false>(ip, context);
+	case Opcode::CHOICE: {
+		const std::uint32_t end = ip + instruction.size;
+		for (std::uint32_t child = ip + 1; child < end; child += instructions[child].size) {
+			const Result result = execute(child, context);
+			if (result != Result::FAILURE) {
+				return result;
+			}
+		}
+		return Result::FAILURE;
+	}
+	case Opcode::REPETITION: {
+		const std::uint32_t child = ip + 1;
+		if (instruction.a == 1) {
+			const Result result = execute(child, context);
 			if (result != Result::SUCCESS) {
 				return result;
 			}
 		}
-		else if constexpr (MIN_REPETITIONS > 1) {
-			const auto save_point = context.save();
-			for (std::size_t i = 0; i < MIN_REPETITIONS; ++i) {
-				const Result result = t.template parse<can_checkpoint && T::always_succeeds()>(context);
-				if (result != Result::SUCCESS) {
-					if (result == Result::FAILURE) {
-						context.restore(save_point);
-					}
-					return result;
-				}
+		else if (instruction.a > 1) {
+			const std::uint32_t minimum_child = instruction.has_minimum_child ? child + instructions[child].size : child;
+			const Result result = instruction.emits_spans ? execute_minimum_repetitions<true>(ip, minimum_child, context) : execute_minimum_repetitions<false>(ip, minimum_child, context);
+			if (result != Result::SUCCESS) {
+				return result;
 			}
 		}
-		static_assert(MAX_REPETITIONS != 0 || !T::always_succeeds(), "infinite loop in grammar");
-		if constexpr (can_checkpoint && MAX_REPETITIONS != 1) {
+		if (instruction.can_checkpoint && instruction.b != 1) {
 			return context.add_scope([&]() {
 				context.skip_to_checkpoint();
-				for (std::size_t i = MIN_REPETITIONS; (MAX_REPETITIONS == 0 || i < MAX_REPETITIONS); ++i) {
-					const Result result = t.template parse<can_checkpoint>(context);
-					if (result != Result::SUCCESS) {
-						return result == Result::FAILURE ? Result::SUCCESS : result;
-					}
-					if (context.add_checkpoint()) {
-						return Result::PARTIAL_SUCCESS;
-					}
-				}
-				return Result::SUCCESS;
+				return execute_repetitions<true>(ip, child, context);
 			});
 		}
-		else {
-			for (std::size_t i = MIN_REPETITIONS; MAX_REPETITIONS == 0 || i < MAX_REPETITIONS; ++i) {
-				const Result result = t.template parse<can_checkpoint>(context);
-				if (result != Result::SUCCESS) {
-					return result == Result::FAILURE ? Result::SUCCESS : result;
-				}
-			}
-			return Result::SUCCESS;
-		}
+		return execute_repetitions<false>(ip, child, context);
 	}
-};
-
-template <class T> class And {
-	T t;
-public:
-	static constexpr bool always_succeeds() {
-		return T::always_succeeds();
+	case Opcode::AND:
+	case Opcode::NOT:
+		return instruction.emits_spans ? execute_lookahead<true>(ip, context) : execute_lookahead<false>(ip, context);
+	case Opcode::HIGHLIGHT: {
+		const int old_style = context.change_style(static_cast<int>(instruction.a));
+		const Result result = execute(ip + 1, context);
+		context.change_style(old_style);
+		return result;
 	}
-	constexpr And(T t): t(t) {}
-	template <bool can_checkpoint> Result parse(ParseContext& context) const {
-		const auto save_point = context.save();
-		if (t.template parse<false>(context) == Result::SUCCESS) {
-			context.restore(save_point);
-			return Result::SUCCESS;
-		}
-		else {
-			return Result::FAILURE;
+	case Opcode::CALL:
+		return execute(subroutine_addresses[instruction.a], context);
+	case Opcode::EMBED:
+		if (instruction.can_checkpoint) {
+			return context.add_embedded_scope<true>(strings[instruction.a], guests[instruction.b]);
 		}
+		return context.add_embedded_scope<false>(strings[instruction.a], guests[instruction.b]);
 	}
-};
+	return Result::FAILURE;
+}
 
-template <class T> class Not {
-	T t;
-public:
-	static constexpr bool always_succeeds() {
-		return false;
-	}
-	constexpr Not(T t): t(t) {}
-	template <bool can_checkpoint> Result parse(ParseContext& context) const {
-		const auto save_point = context.save();
-		if (t.template parse<false>(context) == Result::SUCCESS) {
-			context.restore(save_point);
-			return Result::FAILURE;
+// whether pos is at or after the end of the input
+static bool is_end(const Input* input, std::size_t pos) {
+	const auto chunk_pair = input->get_chunk(pos);
+	return pos - chunk_pair.second >= chunk_pair.first.size;
+}
+
+// an open addressing hash table from file extensions to languages
+class FileExtensions {
+	struct Entry {
+		StringView extension;
+		const Language* language = nullptr;
+	};
+	std::vector<Entry> entries;
+	std::size_t size;
+	static std::size_t hash(const StringView& s) {
+		std::uint32_t hash = 2166136261u;
+		for (char c: s) {
+			hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
 		}
-		else {
-			return Result::SUCCESS;
+		return hash;
+	}
+	void insert_entry(const Entry& entry) {
+		std::size_t i = hash(entry.extension) % entries.size();
+		while (entries[i].language) {
+			if (entries[i].extension == entry.extension) {
+				return;
+			}
+			i = (i + 1) % entries.size();
 		}
+		entries[i] = entry;
+		++size;
 	}
-};
-
-template <class T> class Highlight {
-	T t;
-	int style;
 public:
-	static constexpr bool always_succeeds() {
-		return T::always_succeeds();
+	FileExtensions(): entries(64), size(0) {}
+	void insert(const StringView& extension, const Language* language) {
+		if (2 * (size + 1) > entries.size()) {
+			std::vector<Entry> old_entries(entries.size() * 2);
+			std::swap(entries, old_entries);
+			size = 0;
+			for (const Entry& entry: old_entries) {
+				if (entry.language) {
+					insert_entry(entry);
+				}
+			}
+		}
+		insert_entry({extension, language});
 	}
-	constexpr Highlight(T t, int style): t(t), style(style) {}
-	template <bool can_checkpoint> Result parse(ParseContext& context) const {
-		const int old_style = context.change_style(style);
-		const Result result = t.template parse<can_checkpoint>(context);
-		context.change_style(old_style);
-		return result;
+	const Language* find(const StringView& extension) const {
+		for (std::size_t i = hash(extension) % entries.size(); entries[i].language; i = (i + 1) % entries.size()) {
+			if (entries[i].extension == extension) {
+				return entries[i].language;
+			}
+		}
+		return nullptr;
 	}
 };
 
-template <class T> class Reference {
+class Registry {
+	std::vector<const Language*> languages;
+	FileExtensions file_extensions;
 public:
-	static constexpr bool always_succeeds() {
-		return decltype(T::expression)::always_succeeds();
+	void add(const Language* language) {
+		for (const Language* registered_language: languages) {
+			if (registered_language == language) {
+				return;
+			}
+		}
+		languages.push_back(language);
+		const char* extension = language->file_extensions;
+		for (const char* i = extension; ; ++i) {
+			if (*i == ' ' || *i == '\0') {
+				if (i > extension) {
+					file_extensions.insert(StringView(extension, i - extension), language);
+				}
+				if (*i == '\0') {
+					break;
+				}
+				extension = i + 1;
+			}
+		}
 	}
-	template <bool can_checkpoint> Result parse(ParseContext& context) const {
-		return T::expression.template parse<can_checkpoint>(context);
+	const Language* find_by_extension(const StringView& extension) const {
+		return file_extensions.find(extension);
+	}
+	const Language* find_by_content(const Input* input) const {
+		std::pmr::vector<Span> spans;
+		ParseContext context(input, spans, 0, 0);
+		for (const Language* language: languages) {
+			if (language->parse_content(context)) {
+				return language;
+			}
+		}
+		return nullptr;
 	}
 };
 
-constexpr auto get_expression(char c) {
-	return Char([c](char i) {
-		return i == c;
-	});
+static Registry& get_registry() {
+	static Registry registry;
+	return registry;
 }
-constexpr String get_expression(const char* s) {
-	return String(s);
+
+static StringView get_file_extension(const char* file_name) {
+	const char* extension = nullptr;
+	for (const char* i = file_name; *i != '\0'; ++i) {
+		if (*i == '.') {
+			extension = i + 1;
+		}
+	}
+	return extension ? StringView(extension) : StringView();
 }
-constexpr auto get_expression(bool (*f)(char)) {
-	return Char(f);
+
+void prism::register_language(const Language* language) {
+	get_registry().add(language);
 }
-template <class T> constexpr T get_expression(T expression) {
-	return expression;
+
+const Language* prism::get_language(const char* file_name, const Input* input) {
+	if (const Language* language = get_registry().find_by_extension(get_file_extension(file_name))) {
+		return language;
+	}
+	if (input == nullptr) {
+		return nullptr;
+	}
+	return get_registry().find_by_content(input);
 }
 
-constexpr auto range(char first, char last) {
-	return Char([first, last](char c) {
-		return c >= first && c <= last;
+// parses as if the input ended at end, the checkpoints that looked at it are dropped unless the input really ends there
+template <class V, class F> static bool parse_window(const Language* language, const Input* input, Cache& cache, std::size_t window_start, std::size_t window_end, V& spans, F set_limits, std::size_t end = -1) {
+	ParseContext context(input, spans, window_start, window_end);
+	set_limits(context);
+	context.set_end(end);
+	context.add_root_scope(cache, [&]() {
+		language->parse(context);
 	});
+	context.change_style(Style::DEFAULT);
+	if (context.is_end_reached() && !is_end(input, end)) {
+		cache.invalidate_end(end);
+	}
+	return !context.is_stopped();
 }
-constexpr auto any_char() {
-	return Char([](char c) {
-		return c != '\0';
-	});
+
+std::vector<Span> prism::highlight(const Language* language, const Input* input, Cache& cache, std::size_t window_start, std::size_t window_end) {
+	std::vector<Span> spans;
+	parse_window(language, input, cache, window_start, window_end, spans, [](ParseContext&) {});
+	return spans;
 }
-template <class... T> constexpr Sequence<T...> sequence_(T... t) {
-	return Sequence<T...>(t...);
+
+std::pmr::vector<Span> prism::highlight(const Language* language, const Input* input, Cache& cache, std::size_t window_start, std::size_t window_end, std::pmr::memory_resource* resource) {
+	std::pmr::vector<Span> spans(resource);
+	parse_window(language, input, cache, window_start, window_end, spans, [](ParseContext&) {});
+	return spans;
 }
-template <class... T> constexpr auto sequence(T... t) {
-	return sequence_(get_expression(t)...);
+
+HighlightResult prism::highlight(const Language* language, const Input* input, Cache& cache, std::size_t window_start, std::size_t window_end, const Budget& budget, std::pmr::memory_resource* resource) {
+	HighlightResult result{std::pmr::vector<Span>(resource), false};
+	const std::size_t end = window_end + std::min(budget.overshoot, static_cast<std::size_t>(-1) - window_end);
+	result.complete = parse_window(language, input, cache, window_start, window_end, result.spans, [&](ParseContext& context) {
+		context.set_budget(budget);
+	}, end);
+	return result;
+}
+
+SpanQueue::SpanQueue(std::size_t capacity): head(0), tail(0), closed(false), waiting(0) {
+	this->capacity = 1;
+	while (this->capacity < capacity) {
+		this->capacity *= 2;
+	}
+	buffer.reset(new Span[this->capacity]);
 }
-template <class... T> constexpr Choice<T...> choice_(T... t) {
-	return Choice<T...>(t...);
+template <class F> void SpanQueue::wait(F is_ready) {
+	for (std::size_t i = 0; i < SPIN_COUNT; ++i) {
+		if (is_ready()) {
+			return;
+		}
+		std::this_thread::yield();
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	waiting.fetch_add(1, std::memory_order_relaxed);
+	// pairs with the fence in wake, either the other thread sees waiting or is_ready sees what it changed
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	condition_variable.wait(lock, is_ready);
+	waiting.fetch_sub(1, std::memory_order_relaxed);
 }
-template <class... T> constexpr auto choice(T... t) {
-	return choice_(get_expression(t)...);
+void SpanQueue::wake() {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiting.load(std::memory_order_relaxed) > 0) {
+		// the waiting thread holds the mutex until it waits on the condition variable
+		std::lock_guard<std::mutex> lock(mutex);
+		condition_variable.notify_all();
+	}
 }
-template <std::size_t MIN_REPETITIONS, std::size_t MAX_REPETITIONS, class T> constexpr Repetition<MIN_REPETITIONS, MAX_REPETITIONS, T> repetition_(T t) {
-	return Repetition<MIN_REPETITIONS, MAX_REPETITIONS, T>(t);
+void SpanQueue::add_spans(const Span* spans, std::size_t size) {
+	std::size_t tail = this->tail.load(std::memory_order_relaxed);
+	while (size > 0) {
+		const std::size_t free = capacity - (tail - head.load(std::memory_order_acquire));
+		if (free == 0) {
+			wait([&]() {
+				return tail - head.load(std::memory_order_acquire) < capacity;
+			});
+			continue;
+		}
+		const std::size_t count = std::min(size, free);
+		for (std::size_t i = 0; i < count; ++i) {
+			buffer[(tail + i) & (capacity - 1)] = spans[i];
+		}
+		tail += count;
+		this->tail.store(tail, std::memory_order_release);
+		wake();
+		spans += count;
+		size -= count;
+	}
 }
-template <std::size_t MIN_REPETITIONS = 0, std::size_t MAX_REPETITIONS = 0, class T> constexpr auto repetition(T t) {
-	return repetition_<MIN_REPETITIONS, MAX_REPETITIONS>(get_expression(t));
+void SpanQueue::close() {
+	closed.store(true, std::memory_order_release);
+	wake();
 }
-template <class T> constexpr auto zero_or_more(T t) {
-	return repetition<0>(t);
+std::size_t SpanQueue::get_spans(Span* spans, std::size_t size) {
+	const std::size_t head = this->head.load(std::memory_order_relaxed);
+	while (true) {
+		// closed has to be read before tail, otherwise spans that are added right before closing could be missed
+		const bool closed = this->closed.load(std::memory_order_acquire);
+		const std::size_t available = tail.load(std::memory_order_acquire) - head;
+		if (available > 0) {
+			const std::size_t count = std::min(size, available);
+			for (std::size_t i = 0; i < count; ++i) {
+				spans[i] = buffer[(head + i) & (capacity - 1)];
+			}
+			this->head.store(head + count, std::memory_order_release);
+			wake();
+			return count;
+		}
+		if (closed || size == 0) {
+			return 0;
+		}
+		wait([&]() {
+			return this->closed.load(std::memory_order_acquire) || tail.load(std::memory_order_acquire) != head;
+		});
+	}
 }
-template <class T> constexpr auto one_or_more(T t) {
-	return repetition<1>(t);
+
+void prism::highlight_stream(const Language* language, const Input* input, Cache& cache, SpanSink& sink, std::size_t window_size, std::size_t sparse_distance, std::pmr::memory_resource* resource) {
+	std::pmr::vector<Span> spans(resource);
+	// the last span of a window is held back in case it continues in the next window
+	Span pending(0, 0, Style::DEFAULT);
+	for (std::size_t window_start = 0; !is_end(input, window_start); window_start += window_size) {
+		spans.clear();
+		parse_window(language, input, cache, window_start, window_start + window_size, spans, [](ParseContext&) {});
+		if (!spans.empty() && pending && spans.front().start == pending.end && spans.front().style == pending.style) {
+			spans.front().start = pending.start;
+		}
+		else if (pending) {
+			sink.add_spans(&pending, 1);
+		}
+		pending = Span(0, 0, Style::DEFAULT);
+		if (!spans.empty()) {
+			pending = spans.back();
+			sink.add_spans(spans.data(), spans.size() - 1);
+		}
+		cache.prune(window_start, sparse_distance);
+	}
+	if (pending) {
+		sink.add_spans(&pending, 1);
+	}
 }
-template <class T> constexpr auto optional(T t) {
-	return repetition<0, 1>(t);
+
+Lines prism::highlight_lines(const Language* language, const Input* input, Cache& cache, std::size_t first_line, std::size_t count, std::pmr::memory_resource* resource) {
+	Lines lines(resource);
+	const std::size_t window_start = cache.get_line_start(input, first_line);
+	if (count == 0 || window_start == static_cast<std::size_t>(-1)) {
+		return lines;
+	}
+	std::size_t last_line = first_line;
+	while (last_line + 1 < first_line + count && cache.get_line_start(input, last_line + 1) != static_cast<std::size_t>(-1)) {
+		++last_line;
+	}
+	const std::size_t window_end = cache.get_line_end(input, last_line);
+	const std::pmr::vector<Span> spans = highlight(language, input, cache, window_start, window_end, resource);
+	auto span = spans.begin();
+	for (std::size_t line = first_line; line <= last_line; ++line) {
+		const std::size_t line_start = cache.get_line_start(input, line);
+		const std::size_t line_end = cache.get_line_end(input, line);
+		for (; span != spans.end() && span->start < line_end; ++span) {
+			if (span->end > line_end) {
+				// the rest of the span belongs to the following lines
+				lines.add_span(Span(std::max(span->start, line_start), line_end, span->style));
+				break;
+			}
+			lines.add_span(Span(std::max(span->start, line_start), span->end, span->style));
+		}
+		lines.add_line(Range(line_start, line_end));
+	}
+	return lines;
 }
-template <class T> constexpr auto and_(T t) {
-	return And(get_expression(t));
+
+Lines prism::highlight_lines(const Language* language, const Input* input, Cache& cache, std::size_t first_line, std::size_t count, std::size_t first_column, std::size_t last_column, std::pmr::memory_resource* resource) {
+	Lines lines(resource);
+	std::pmr::vector<Span> spans(resource);
+	for (std::size_t line = first_line; line - first_line < count; ++line) {
+		const std::size_t line_start = cache.get_line_start(input, line);
+		if (line_start == static_cast<std::size_t>(-1)) {
+			break;
+		}
+		const std::size_t line_end = cache.get_line_end(input, line);
+		const std::size_t window_start = line_start + std::min(first_column, line_end - line_start);
+		const std::size_t window_end = line_start + std::min(last_column, line_end - line_start);
+		// every line is a window of its own, the columns of a long line that are not visible produce no spans
+		if (window_start < window_end) {
+			spans.clear();
+			parse_window(language, input, cache, window_start, window_end, spans, [](ParseContext&) {});
+			for (const Span& span: spans) {
+				lines.add_span(span);
+			}
+		}
+		lines.add_line(Range(window_start, std::max(window_start, window_end)));
+	}
+	return lines;
 }
-template <class T> constexpr auto not_(T t) {
-	return Not(get_expression(t));
+
+std::vector<FoldingRange> prism::folding_ranges(const Language* language, const Input* input, Cache& cache, FoldingIndex& index) {
+	index.update(language, input, cache, -1);
+	std::vector<FoldingRange> ranges;
+	const std::vector<BracketIndex::Bracket>& brackets = index.get_brackets().get_brackets();
+	const std::vector<FoldingIndex::Comment>& comments = index.get_comments();
+	// the brackets and the comments are both sorted, the comment blocks that start before a line are added before the brackets on it
+	std::size_t i = 0;
+	auto add_comment_blocks = [&](std::size_t line) {
+		while (i < comments.size() && comments[i].start_line < line) {
+			const std::size_t start_line = comments[i].start_line;
+			std::size_t end_line = comments[i].end_line;
+			for (++i; i < comments.size() && comments[i].continues_block; ++i) {
+				end_line = comments[i].end_line;
+			}
+			if (end_line > start_line) {
+				ranges.push_back({start_line, end_line, true});
+			}
+		}
+	};
+	for (const BracketIndex::Bracket& bracket: brackets) {
+		if (get_closing_bracket(bracket.c) && bracket.match != static_cast<std::size_t>(-1)) {
+			const std::size_t end_line = brackets[bracket.match].line;
+			if (end_line > bracket.line) {
+				add_comment_blocks(bracket.line);
+				ranges.push_back({bracket.line, end_line, false});
+			}
+		}
+	}
+	add_comment_blocks(-1);
+	return ranges;
 }
-template <class T> constexpr auto highlight(int style, T t) {
-	return Highlight(get_expression(t), style);
+
+Prefetcher::Prefetcher(std::size_t distance): distance(distance), interrupt(false), quit(false), language(nullptr), input(nullptr), cache(nullptr), pos(0) {
+	thread = std::thread([this]() {
+		run();
+	});
 }
-template <class T> constexpr auto any_char_but(T t) {
-	return sequence(not_(t), any_char());
+Prefetcher::~Prefetcher() {
+	{
+		interrupt = true;
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	condition_variable.notify_one();
+	thread.join();
 }
-constexpr auto end() {
-	return not_(any_char());
+void Prefetcher::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		condition_variable.wait(lock, [this]() {
+			return quit || cache != nullptr;
+		});
+		if (quit) {
+			return;
+		}
+		// an empty window makes the parser only build checkpoints
+		// the interrupt is only seen at checkpoints, so every step treats the input as ending at its end
+		// and a long token like an unterminated comment does not keep a highlight waiting for more than the rest of the distance
+		const std::size_t target = pos + std::min(distance, static_cast<std::size_t>(-1) - pos);
+		std::size_t restart_pos = -1;
+		for (std::size_t step_end = pos; step_end < target && !interrupt.load(std::memory_order_relaxed) && !is_end(input, step_end);) {
+			// a step that did not get past the start of a token is not repeated in small steps, the rest is parsed at once
+			const std::size_t previous_restart_pos = restart_pos;
+			restart_pos = cache->get_restart_pos(step_end, -1);
+			step_end = restart_pos == previous_restart_pos ? target : step_end + std::min(STEP, target - step_end);
+			std::pmr::vector<Span> spans;
+			parse_window(language, input, *cache, step_end, step_end, spans, [this](ParseContext& context) {
+				context.set_interrupt(&interrupt);
+			}, step_end);
+		}
+		cache = nullptr;
+	}
 }
-template <class T> constexpr auto ends_with(T t) {
-	const auto e = sequence(t, end());
-	return sequence(repetition(any_char_but(e)), e);
+std::vector<Span> Prefetcher::highlight(const Language* language, const Input* input, Cache& cache, std::size_t window_start, std::size_t window_end) {
+	std::vector<Span> spans;
+	{
+		// the background thread releases the mutex at its next checkpoint or at the end of its step
+		interrupt = true;
+		std::lock_guard<std::mutex> lock(mutex);
+		interrupt = false;
+		parse_window(language, input, cache, window_start, window_end, spans, [](ParseContext&) {});
+		this->language = language;
+		this->input = input;
+		this->cache = &cache;
+		this->pos = window_end;
+	}
+	condition_variable.notify_one();
+	return spans;
 }
-template <class T> constexpr auto reference() {
-	return Reference<T>();
+void Prefetcher::stop() {
+	interrupt = true;
+	std::lock_guard<std::mutex> lock(mutex);
+	interrupt = false;
+	cache = nullptr;
 }
 
-template <class... T> constexpr auto scope(T... t) {
-	return choice(t...);
-}
-template <class S, class E, class... T> constexpr auto nested_scope(int style, S start, E end, T... t) {
-	return highlight(style, sequence(
-		start,
-		repetition(sequence(not_(end), choice(t..., any_char()))),
-		optional(end)
-	));
+static void write_varint(std::string& data, std::uint64_t value) {
+	while (value >= 0x80) {
+		data.push_back(static_cast<char>(value | 0x80));
+		value >>= 7;
+	}
+	data.push_back(static_cast<char>(value));
 }
-template <class T> constexpr auto root_scope(T t) {
-	return repetition(choice(t, any_char()));
+static bool read_varint(const char*& i, const char* end, std::uint64_t& value) {
+	value = 0;
+	for (unsigned shift = 0; i != end && shift < 64; shift += 7) {
+		const unsigned char c = *i++;
+		value |= static_cast<std::uint64_t>(c & 0x7F) << shift;
+		if ((c & 0x80) == 0) {
+			return true;
+		}
+	}
+	return false;
 }
 
-struct Language {
-	const char* name;
-	bool (*parse_file_name)(ParseContext&);
-	void (*parse)(ParseContext&);
-};
-
-template <class parse_file_name, class parse> constexpr Language language(const char* name) {
-	return {
-		name,
-		[](ParseContext& context) {
-			return reference<parse_file_name>().template parse<false>(context) == Result::SUCCESS;
-		},
-		[](ParseContext& context) {
-			root_scope(reference<parse>()).template parse<true>(context);
+std::string prism::encode_spans(const std::vector<Span>& spans) {
+	std::string data;
+	data.reserve(spans.size() * 3);
+	std::size_t last_end = 0;
+	Span pending(0, 0, Style::DEFAULT);
+	auto flush = [&]() {
+		if (pending) {
+			write_varint(data, static_cast<std::uint64_t>(pending.start - last_end) << 4 | pending.style);
+			write_varint(data, pending.end - pending.start);
+			last_end = pending.end;
 		}
 	};
+	for (const Span& span: spans) {
+		if (span.style < 0 || span.style > 0xF || span.start < std::max(last_end, pending.end) || span.end <= span.start) {
+			continue;
+		}
+		if (pending && span.start == pending.end && span.style == pending.style) {
+			pending.end = span.end;
+			continue;
+		}
+		flush();
+		pending = span;
+	}
+	flush();
+	return data;
+}
+bool prism::decode_spans(const StringView& data, std::vector<Span>& spans, std::size_t size) {
+	const char* i = data.data();
+	const char* end = data.data() + data.size();
+	std::size_t last_end = 0;
+	// every span takes at least two bytes
+	spans.reserve(spans.size() + data.size() / 2);
+	while (i != end) {
+		std::uint64_t head;
+		std::uint64_t length;
+		if (!read_varint(i, end, head) || !read_varint(i, end, length)) {
+			return false;
+		}
+		// checking every span keeps corrupt data from wrapping a span around to before the previous one
+		if ((head >> 4) > size - last_end || length > size - last_end - (head >> 4)) {
+			return false;
+		}
+		const std::size_t start = last_end + (head >> 4);
+		last_end = start + length;
+		spans.emplace_back(start, last_end, static_cast<int>(head & 0xF));
+	}
+	return true;
 }
 
-constexpr auto hex_digit = choice(range('0', '9'), range('a', 'f'), range('A', 'F'));
-
-#include "languages/c.hpp"
-#include "languages/java.hpp"
-#include "languages/xml.hpp"
-#include "languages/javascript.hpp"
-#include "languages/json.hpp"
-#include "languages/python.hpp"
-#include "languages/rust.hpp"
-#include "languages/toml.hpp"
-#include "languages/haskell.hpp"
-
-constexpr Language languages[] = {
-	language<c_file_name, c_language>("C"),
-	language<java_file_name, java_language>("Java"),
-	language<xml_file_name, xml_language>("XML"),
-	language<javascript_file_name, javascript_language>("JavaScript"),
-	language<json_file_name, json_language>("JSON"),
-	language<python_file_name, python_language>("Python"),
-	language<rust_file_name, rust_language>("Rust"),
-	language<toml_file_name, toml_language>("TOML"),
-	language<haskell_file_name, haskell_language>("Haskell"),
+// SHA-256, so that crafted inputs can not share a file with other inputs and poison their spans
+class Sha256 {
+	static constexpr std::uint32_t K[64] = {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+	};
+	std::uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+	unsigned char block[64];
+	std::size_t block_size = 0;
+	std::uint64_t size = 0;
+	static std::uint32_t rotate(std::uint32_t x, int n) {
+		return (x >> n) | (x << (32 - n));
+	}
+	void process_block() {
+		std::uint32_t w[64];
+		for (int i = 0; i < 16; ++i) {
+			w[i] = static_cast<std::uint32_t>(block[4 * i]) << 24 | static_cast<std::uint32_t>(block[4 * i + 1]) << 16 | static_cast<std::uint32_t>(block[4 * i + 2]) << 8 | block[4 * i + 3];
+		}
+		for (int i = 16; i < 64; ++i) {
+			const std::uint32_t s0 = rotate(w[i - 15], 7) ^ rotate(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			const std::uint32_t s1 = rotate(w[i - 2], 17) ^ rotate(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+		std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+		for (int i = 0; i < 64; ++i) {
+			const std::uint32_t t1 = h + (rotate(e, 6) ^ rotate(e, 11) ^ rotate(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+			const std::uint32_t t2 = (rotate(a, 2) ^ rotate(a, 13) ^ rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+public:
+	void update(const char* data, std::size_t data_size) {
+		size += data_size;
+		while (data_size > 0) {
+			const std::size_t n = std::min(data_size, sizeof(block) - block_size);
+			std::memcpy(block + block_size, data, n);
+			block_size += n;
+			data += n;
+			data_size -= n;
+			if (block_size == sizeof(block)) {
+				process_block();
+				block_size = 0;
+			}
+		}
+	}
+	// the digest as 64 hexadecimal digits
+	std::string finish() {
+		const std::uint64_t bits = size * 8;
+		const char padding = static_cast<char>(0x80);
+		update(&padding, 1);
+		while (block_size != 56) {
+			const char zero = 0;
+			update(&zero, 1);
+		}
+		for (int i = 7; i >= 0; --i) {
+			block[block_size++] = static_cast<unsigned char>(bits >> (8 * i));
+		}
+		process_block();
+		std::string digest;
+		for (std::uint32_t word: state) {
+			char hex[9];
+			std::snprintf(hex, sizeof(hex), "%08x", word);
+			digest += hex;
+		}
+		return digest;
+	}
 };
 
-const Language* prism::get_language(const char* file_name) {
-	StringInput input(file_name);
-	std::vector<Span> spans;
-	ParseContext context(&input, spans, 0, input.size());
-	for (const Language& language: languages) {
-		if (language.parse_file_name(context)) {
-			return &language;
-		}
+// hashes the whole input and sets size to its size
+static std::string hash_input(const Input* input, std::size_t& size) {
+	Sha256 sha256;
+	size = 0;
+	for (Input::Chunk chunk = input->get_chunk(0).first; chunk.size > 0; chunk = input->get_next_chunk(chunk.chunk)) {
+		sha256.update(chunk.data, chunk.size);
+		size += chunk.size;
 	}
-	return nullptr;
+	return sha256.finish();
 }
 
-std::vector<Span> prism::highlight(const Language* language, const Input* input, Cache& cache, std::size_t window_start, std::size_t window_end) {
+SpanStore::SpanStore(const std::string& directory): directory(directory) {}
+std::string SpanStore::get_path(const Language* language, const Input* input, std::size_t& size) const {
+	const std::string hash = hash_input(input, size);
+	char version[32];
+	std::snprintf(version, sizeof(version), "-%u-", language->version);
+	return directory + '/' + language->name + version + hash + ".spans";
+}
+bool SpanStore::read(const std::string& path, std::size_t size, std::vector<Span>& spans) {
+	std::FILE* file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr) {
+		return false;
+	}
+	std::string data;
+	char buffer[64 * 1024];
+	while (const std::size_t count = std::fread(buffer, 1, sizeof(buffer), file)) {
+		data.append(buffer, count);
+	}
+	const bool error = std::ferror(file);
+	std::fclose(file);
+	std::vector<Span> decoded_spans;
+	if (error || !prism::decode_spans(StringView(data.data(), data.size()), decoded_spans, size)) {
+		return false;
+	}
+	spans = std::move(decoded_spans);
+	return true;
+}
+void SpanStore::write(const std::string& path, const std::vector<Span>& spans) {
+	const std::string data = prism::encode_spans(spans);
+	// the file is written under a temporary name and renamed, so readers never see a partial file
+	std::random_device random;
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", random(), random());
+	const std::string temporary_path = path + suffix;
+	std::FILE* file = std::fopen(temporary_path.c_str(), "wb");
+	if (file == nullptr) {
+		return;
+	}
+	const bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+	if (std::fclose(file) != 0 || !written || std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+		std::remove(temporary_path.c_str());
+	}
+}
+bool SpanStore::load(const Language* language, const Input* input, std::vector<Span>& spans) const {
+	std::size_t size;
+	const std::string path = get_path(language, input, size);
+	return read(path, size, spans);
+}
+void SpanStore::store(const Language* language, const Input* input, const std::vector<Span>& spans) const {
+	std::size_t size;
+	write(get_path(language, input, size), spans);
+}
+std::vector<Span> SpanStore::highlight(const Language* language, const Input* input) const {
+	std::size_t size;
+	const std::string path = get_path(language, input, size);
 	std::vector<Span> spans;
-	ParseContext context(input, spans, window_start, window_end);
-	context.add_root_scope(cache, [&]() {
-		language->parse(context);
-	});
-	context.change_style(Style::DEFAULT);
+	if (read(path, size, spans)) {
+		return spans;
+	}
+	Cache cache;
+	spans = prism::highlight(language, input, cache, 0, size);
+	write(path, spans);
 	return spans;
 }
+
+std::vector<RuleProfile> prism::get_profile() {
+#ifdef PRISM_PROFILE
+	return profiler.get_profile();
+#else
+	return std::vector<RuleProfile>();
+#endif
+}
+
+void prism::reset_profile() {
+#ifdef PRISM_PROFILE
+	profiler.reset();
+#endif
+}
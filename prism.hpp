@@ -4,6 +4,19 @@
 #include <utility>
 #include <algorithm>
 #include <vector>
+#include <tuple>
+#include <chrono>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <memory>
+#include <string>
+#include <memory_resource>
 
 class StringView {
 	const char* data_;
@@ -199,6 +212,27 @@ public:
 	}
 };
 
+// an input that grows at the end, e.g. for text that arrives through a pipe
+// the data before a position can be released once it is not needed anymore
+class AppendableInput final: public Input {
+	static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+	std::deque<std::unique_ptr<char[]>> chunks;
+	// the index of the first chunk that has not been released
+	std::size_t first_chunk;
+	std::size_t size_;
+	Chunk get_chunk_by_index(std::size_t index) const;
+public:
+	AppendableInput(): first_chunk(0), size_(0) {}
+	std::size_t size() const {
+		return size_;
+	}
+	void append(const char* data, std::size_t size);
+	// the data before pos must not be accessed anymore
+	void release(std::size_t pos);
+	std::pair<Chunk, std::size_t> get_chunk(std::size_t pos) const override;
+	Chunk get_next_chunk(const void* chunk) const override;
+};
+
 class Cache {
 public:
 	struct Checkpoint {
@@ -206,30 +240,456 @@ public:
 		std::size_t max_pos;
 	};
 	struct Node {
+		// the children and checkpoints are allocated from the memory resource of the cache
+		using allocator_type = std::pmr::polymorphic_allocator<Node>;
 		std::size_t start_pos;
 		std::size_t start_max_pos;
-		std::vector<Checkpoint> checkpoints;
-		std::vector<Node> children;
-		Node(std::size_t start_pos, std::size_t start_max_pos);
+		std::pmr::vector<Checkpoint> checkpoints;
+		std::pmr::vector<Node> children;
+		// embedded regions remember where they end and the delimiter that ends them
+		std::size_t end_pos;
+		const char* end_delimiter;
+		Node(std::size_t start_pos, std::size_t start_max_pos, const allocator_type& allocator = {});
+		Node(const Node& node) = default;
+		Node(Node&& node) = default;
+		Node(const Node& node, const allocator_type& allocator);
+		Node(Node&& node, const allocator_type& allocator);
+		Node& operator =(const Node& node) = default;
+		Node& operator =(Node&& node) = default;
 		std::size_t get_last_checkpoint() const;
 		void add_checkpoint(std::size_t pos, std::size_t max_pos);
 		const Checkpoint* find_checkpoint(std::size_t pos) const;
 		Node* find_child(std::size_t pos);
 		Node* add_child(std::size_t pos, std::size_t max_pos);
 		void invalidate(std::size_t pos);
+		void invalidate_end(std::size_t end);
+		// the checkpoints and children that looked at pos also depend on the input up to max_pos
+		void raise_max_pos(std::size_t pos, std::size_t max_pos);
+		void shift(std::size_t deleted, std::size_t inserted);
+		std::size_t get_size() const;
+		void thin();
+		void prune(std::size_t limit, std::size_t distance);
 	};
 private:
 	Node root_node;
+	// line_starts[i] is where line i starts, the newlines before lines_end have been indexed
+	std::pmr::vector<std::size_t> line_starts;
+	std::size_t lines_end;
+	bool lines_complete;
+	// the checkpoints and children of the outermost repetition behind the edits, at their new positions
+	// parsing that reaches one of these checkpoints in the outermost repetition is in the same state as before the edits
+	Node tail;
+	// the checkpoints of the tail before tail_first have been passed
+	std::size_t tail_first;
+	std::size_t tail_id;
+	std::size_t resume_pos;
+	void index_lines(const Input* input, std::size_t line);
+	void invalidate_lines(std::size_t pos);
+	void clear_tail();
+	bool edit_tail(std::size_t pos, std::size_t deleted, std::size_t inserted, bool keep_checkpoints);
 public:
-	Cache();
+	// the checkpoints are allocated from the memory resource, e.g. an arena per document
+	Cache(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 	Node* get_root_node();
 	void invalidate(std::size_t pos);
+	// drops the checkpoints up to end that looked at end after the input was parsed as if it ended there
+	// the checkpoints after end come from parses of the whole input and are kept
+	void invalidate_end(std::size_t end);
+	// updates the cache after deleted bytes at pos have been replaced with inserted bytes, input is the new text
+	// if the edit is inside an embedded region that still ends at the same delimiter, only the region is invalidated
+	// otherwise the checkpoints behind the edit become the tail and are used again once parsing reaches one of them
+	void edit(const Input* input, std::size_t pos, std::size_t deleted, std::size_t inserted);
+	// the next checkpoint of the tail, or -1 if there is none
+	std::size_t get_tail_pos() const;
+	// continues with the tail if it has a checkpoint at pos, node is the outermost repetition
+	bool resume_tail(Node* node, std::size_t pos, std::size_t max_pos);
+	// changes whenever the tail is replaced by the checkpoints of another parse
+	std::size_t get_tail_id() const;
+	// where parsing continued with the tail, or -1 if it has not yet
+	// from there on the spans are the same as before the edits
+	std::size_t get_resume_pos() const;
+	// the number of bytes the cache occupies
+	std::size_t get_size() const;
+	// drops every other checkpoint, highlighting gets slower but stays correct
+	void thin();
+	// where parsing starts when a window from pos on is highlighted, as long as the input only changes from end on
+	// the input before this position is not read again
+	std::size_t get_restart_pos(std::size_t pos, std::size_t end) const;
+	// keeps the checkpoints from limit on but only one checkpoint per distance bytes before limit
+	// nested scopes that are finished before limit are dropped
+	void prune(std::size_t limit, std::size_t distance);
+	// drops every checkpoint, parsing continues at pos as if the input started there
+	void restart(std::size_t pos);
+	// where the line starts, or -1 if the input has fewer lines
+	std::size_t get_line_start(const Input* input, std::size_t line);
+	// where the line ends including its newline, or -1 if the input has fewer lines
+	std::size_t get_line_end(const Input* input, std::size_t line);
+	// the line that contains pos
+	std::size_t get_line(const Input* input, std::size_t pos);
+};
+
+// the spans of consecutive lines, split at line ends and stored in one allocation
+class Lines {
+	std::pmr::vector<Span> spans;
+	std::pmr::vector<Range> ranges;
+	// the spans of line i are spans[offsets[i]] to spans[offsets[i + 1]]
+	std::pmr::vector<std::size_t> offsets;
+public:
+	struct Line {
+		Range range;
+		const Span* first;
+		const Span* last;
+		const Span* begin() const {
+			return first;
+		}
+		const Span* end() const {
+			return last;
+		}
+	};
+	Lines(std::pmr::memory_resource* resource = std::pmr::get_default_resource()): spans(resource), ranges(resource), offsets(1, 0, resource) {}
+	void add_span(const Span& span) {
+		spans.push_back(span);
+	}
+	// adds a line with the spans that have been added since the previous line
+	void add_line(const Range& range) {
+		ranges.push_back(range);
+		offsets.push_back(spans.size());
+	}
+	// the number of lines
+	std::size_t size() const {
+		return ranges.size();
+	}
+	Line operator [](std::size_t i) const {
+		return Line{ranges[i], spans.data() + offsets[i], spans.data() + offsets[i + 1]};
+	}
+};
+
+// remembers the spans of the last highlight of a document and reports where the styling changed since then
+class ChangeTracker {
+	std::vector<Span> spans;
+	// the parts of the document the remembered spans are known for
+	std::vector<Range> known_ranges;
+public:
+	// moves the remembered spans after deleted bytes at pos have been replaced with inserted bytes
+	void edit(std::size_t pos, std::size_t deleted, std::size_t inserted);
+	// remembers the spans of a new highlight and returns the ranges of the window whose style differs from before
+	// inserted text and parts of the window that were not highlighted before count as changed
+	std::vector<Range> update(const std::vector<Span>& spans, std::size_t window_start, std::size_t window_end);
+};
+
+// encodes spans as the integer array of LSP semantic tokens
+// columns count UTF-16 code units, spans that cross a line end become one token per line
+class SemanticTokens {
+public:
+	// the legend, the token type of a span is its style - Style::COMMENT and the tokens have no modifiers
+	static constexpr const char* TOKEN_TYPES[] = {
+		"comment",
+		"keyword",
+		"operator",
+		"type",
+		"number",
+		"string",
+		"escapeSequence",
+		"function"
+	};
+	// replaces delete_count integers at start with data
+	struct Edit {
+		std::size_t start;
+		std::size_t delete_count;
+		std::vector<std::uint32_t> data;
+	};
+private:
+	std::vector<std::uint32_t> data;
+	std::uint64_t result_id;
+public:
+	SemanticTokens(): result_id(0) {}
+	// encodes the spans of the whole input and remembers them as a new result
+	const std::vector<std::uint32_t>& full(const Input* input, const std::vector<Span>& spans);
+	// like full, but returns the edits that turn the previous result into the new one
+	std::vector<Edit> delta(const Input* input, const std::vector<Span>& spans);
+	// identifies the remembered result, a delta request for a different result needs a full response
+	std::uint64_t get_result_id() const {
+		return result_id;
+	}
+	const std::vector<std::uint32_t>& get_data() const {
+		return data;
+	}
+};
+
+// the brackets of the code with their nesting depth and matching bracket, brackets in strings and comments are left out
+// the index is built front to back from the spans of the cache and only as far as it is needed
+class BracketIndex {
+public:
+	struct Bracket {
+		std::size_t pos;
+		std::size_t line;
+		char c;
+		// the number of brackets that enclose it, a pair has the same depth
+		std::size_t depth;
+		// the indices of the matching bracket and of the enclosing opening bracket, or -1
+		std::size_t match;
+		std::size_t parent;
+	};
+private:
+	std::vector<Bracket> brackets;
+	// the indices of the opening brackets that are not closed yet, innermost last
+	std::vector<std::size_t> open_brackets;
+	// the brackets before end are indexed
+	std::size_t end;
+	// the brackets behind the edits up to tail_end at their new positions, like the tail of the cache with tail_id
+	// they are indexed again once the cache continues with its tail
+	std::vector<Bracket> tail;
+	std::size_t tail_end;
+	std::size_t tail_id;
+	void add_bracket(std::size_t pos, std::size_t line, char c);
+	void truncate(const Cache& cache, std::size_t pos);
+	bool resume(const Input* input, Cache& cache);
+	// f gets the spans of every step and the position from which the tail was reused after it, or -1
+	template <class F> void update(const Language* language, const Input* input, Cache& cache, std::size_t end, F f);
+	friend class FoldingIndex;
+public:
+	BracketIndex(): end(0), tail_end(0), tail_id(-1) {}
+	// indexes the brackets up to end
+	// after an edit the input is highlighted in growing steps until the cache continues with its tail, the brackets behind that are reused
+	void update(const Language* language, const Input* input, Cache& cache, std::size_t end);
+	// like update for callers that already have the spans from get_end() to end
+	void add(const Input* input, Cache& cache, const std::vector<Span>& spans, std::size_t end);
+	// moves the brackets behind the edit to their new positions and forgets the brackets whose spans could depend on it, call it after Cache::edit
+	void edit(const Cache& cache, std::size_t pos, std::size_t deleted, std::size_t inserted);
+	// forgets the brackets whose spans could depend on the input from pos on, call it after Cache::invalidate
+	void invalidate(const Cache& cache, std::size_t pos);
+	// the bracket at pos, or nullptr if there is none or pos has not been indexed
+	const Bracket* find(std::size_t pos) const;
+	// the position of the bracket that matches the bracket at pos, or -1
+	std::size_t find_match(std::size_t pos) const;
+	const std::vector<Bracket>& get_brackets() const {
+		return brackets;
+	}
+	std::size_t get_end() const {
+		return end;
+	}
+};
+
+struct FoldingRange {
+	std::size_t start_line;
+	// the line of the closing bracket or of the end of the comment
+	std::size_t end_line;
+	bool comment;
+};
+
+// the brackets and comments that prism::folding_ranges needs, updated incrementally like BracketIndex
+class FoldingIndex {
+public:
+	struct Comment {
+		std::size_t start;
+		std::size_t end;
+		std::size_t start_line;
+		// the line of the last byte
+		std::size_t end_line;
+		// comments on consecutive lines form one block, a blank line starts a new block
+		bool continues_block;
+	};
+private:
+	BracketIndex brackets;
+	std::vector<Comment> comments;
+	// the comments behind the edits at their new positions and old lines, like the tail of the bracket index
+	std::vector<Comment> tail;
+	bool continues_block(const Input* input, std::size_t pos) const;
+	void add_comments(const Input* input, Cache& cache, const std::vector<Span>& spans);
+	void resume(const Input* input, Cache& cache, std::size_t pos);
+	void truncate(const Cache& cache);
+public:
+	void update(const Language* language, const Input* input, Cache& cache, std::size_t end);
+	// call it after Cache::edit
+	void edit(const Cache& cache, std::size_t pos, std::size_t deleted, std::size_t inserted);
+	// call it after Cache::invalidate
+	void invalidate(const Cache& cache, std::size_t pos);
+	const BracketIndex& get_brackets() const {
+		return brackets;
+	}
+	const std::vector<Comment>& get_comments() const {
+		return comments;
+	}
+};
+
+// receives the spans of prism::highlight_stream in order
+class SpanSink {
+public:
+	virtual ~SpanSink() = default;
+	virtual void add_spans(const Span* spans, std::size_t size) = 0;
+};
+
+// a ring buffer that passes spans from one producer thread to one consumer thread, lock-free unless a thread has to wait
+// e.g. prism::highlight_stream parses on one thread while another thread renders the spans it has committed so far
+class SpanQueue final: public SpanSink {
+	std::unique_ptr<Span[]> buffer;
+	// a power of two
+	std::size_t capacity;
+	// only written by the consumer and the producer respectively, both only grow and are taken modulo capacity
+	alignas(64) std::atomic<std::size_t> head;
+	alignas(64) std::atomic<std::size_t> tail;
+	std::atomic<bool> closed;
+	// a thread that has to wait yields SPIN_COUNT times and then parks on the condition variable until the other thread wakes it
+	static constexpr std::size_t SPIN_COUNT = 64;
+	std::mutex mutex;
+	std::condition_variable condition_variable;
+	// the number of threads that park or are about to
+	std::atomic<std::size_t> waiting;
+	template <class F> void wait(F is_ready);
+	void wake();
+public:
+	SpanQueue(std::size_t capacity = 4096);
+	// waits while the queue is full
+	void add_spans(const Span* spans, std::size_t size) override;
+	// tells the consumer that no more spans will be added
+	void close();
+	// waits until spans are available and copies at most size of them, returns 0 once the queue is closed and empty
+	std::size_t get_spans(Span* spans, std::size_t size);
+};
+
+// limits how much a highlight call may parse
+struct Budget {
+	std::chrono::steady_clock::duration time = std::chrono::steady_clock::duration::max();
+	std::size_t bytes = -1;
+	// how far parsing may read past the end of the window, the input is treated as if it ended there
+	// a token that needs to see more than this, e.g. to find its closing delimiter, is highlighted as if the input ended
+	// only prism::highlight with a Budget bounds this, all other highlight functions parse past the window as far as the tokens at its end need
+	std::size_t overshoot = -1;
+};
+
+struct HighlightResult {
+	std::pmr::vector<Span> spans;
+	// false if the budget ran out before the end of the window, the rest of the window has no spans
+	// the cache keeps what was parsed, so the next call continues from there
+	bool complete;
+};
+
+// owns the caches of many documents and keeps their total size within a budget
+// the least recently used caches are thinned first and evicted after that, evicted documents are parsed again on demand
+class CacheManager {
+	struct Entry {
+		Cache cache;
+		std::size_t size;
+		bool thinned;
+		std::list<std::uint64_t>::iterator lru_position;
+	};
+	std::unordered_map<std::uint64_t, Entry> entries;
+	// the least recently used document comes first
+	std::list<std::uint64_t> lru;
+	std::size_t budget;
+	std::size_t size;
+	Entry& use(std::uint64_t document);
+	void update_size(Entry& entry);
+	void enforce_budget();
+public:
+	CacheManager(std::size_t budget);
+	std::vector<Span> highlight(std::uint64_t document, const Language* language, const Input* input, std::size_t window_start, std::size_t window_end);
+	void edit(std::uint64_t document, const Input* input, std::size_t pos, std::size_t deleted, std::size_t inserted);
+	void remove(std::uint64_t document);
+	void set_budget(std::size_t budget);
+	std::size_t get_size() const;
+};
+
+// extends the cache ahead of the last highlighted window on a background thread while no highlight is running
+// checkpoints behind a window already exist because highlighting it had to parse up to it
+class Prefetcher {
+	// the background parse is split into steps of this many bytes
+	static constexpr std::size_t STEP = 64 * 1024;
+	std::size_t distance;
+	std::mutex mutex;
+	std::condition_variable condition_variable;
+	std::atomic<bool> interrupt;
+	bool quit;
+	// the window that was highlighted last and has not been prefetched yet
+	const Language* language;
+	const Input* input;
+	Cache* cache;
+	std::size_t pos;
+	std::thread thread;
+	void run();
+public:
+	Prefetcher(std::size_t distance = 1024 * 1024);
+	~Prefetcher();
+	// interrupts the prefetching, highlights the window and then prefetches up to distance bytes ahead of it
+	std::vector<Span> highlight(const Language* language, const Input* input, Cache& cache, std::size_t window_start, std::size_t window_end);
+	// stops prefetching, this has to be called before the input or the cache of the last highlight is changed
+	void stop();
+};
+
+// keeps the spans of whole inputs in a directory so that content that has been highlighted before is not parsed again
+// the files are named after the language, its version and the SHA-256 hash of the content
+class SpanStore {
+	std::string directory;
+	// hashes the input and sets size to its size
+	std::string get_path(const Language* language, const Input* input, std::size_t& size) const;
+	static bool read(const std::string& path, std::size_t size, std::vector<Span>& spans);
+	static void write(const std::string& path, const std::vector<Span>& spans);
+public:
+	// the directory has to exist
+	SpanStore(const std::string& directory);
+	// returns false if the spans of the input are not stored
+	bool load(const Language* language, const Input* input, std::vector<Span>& spans) const;
+	// errors are ignored, the spans are simply not stored
+	void store(const Language* language, const Input* input, const std::vector<Span>& spans) const;
+	// loads the spans of the whole input or highlights and stores them
+	std::vector<Span> highlight(const Language* language, const Input* input) const;
+};
+
+struct RuleProfile {
+	const char* name;
+	std::size_t invocations;
+	std::size_t successes;
+	std::size_t backtracked_bytes;
+	std::chrono::nanoseconds total_time;
+	std::chrono::nanoseconds self_time;
 };
 
 namespace prism {
 
+// the languages that come with prism, each one is defined in its own translation unit and library
+namespace languages {
+extern const Language c;
+extern const Language java;
+extern const Language xml;
+extern const Language javascript;
+extern const Language json;
+extern const Language python;
+extern const Language rust;
+extern const Language toml;
+extern const Language haskell;
+}
+
 const Theme& get_theme(const char* name);
-const Language* get_language(const char* file_name);
+// makes a language available to get_language, languages that are registered first take precedence
+void register_language(const Language* language);
+// detects the language by the file extension and, if the extension is unknown and an input is given, by its content
+const Language* get_language(const char* file_name, const Input* input = nullptr);
 std::vector<Span> highlight(const Language* language, const Input* input, Cache& cache, std::size_t window_start, std::size_t window_end);
+// allocates the spans from the memory resource, highlighting a window that is already cached allocates nothing else
+std::pmr::vector<Span> highlight(const Language* language, const Input* input, Cache& cache, std::size_t window_start, std::size_t window_end, std::pmr::memory_resource* resource);
+// the memory resource parameters of the following functions work like the one of highlight
+HighlightResult highlight(const Language* language, const Input* input, Cache& cache, std::size_t window_start, std::size_t window_end, const Budget& budget, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+// highlights the whole input front to back in windows of window_size bytes and passes the spans to the sink
+// the cache only keeps the checkpoints of the last window and one checkpoint per sparse_distance bytes before it, so memory stays flat for inputs of any size
+void highlight_stream(const Language* language, const Input* input, Cache& cache, SpanSink& sink, std::size_t window_size = 64 * 1024, std::size_t sparse_distance = 1024 * 1024, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+// highlights count lines starting at first_line, spans that cross a line end are split
+Lines highlight_lines(const Language* language, const Input* input, Cache& cache, std::size_t first_line, std::size_t count, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+// like highlight_lines but only the columns from first_column to last_column of every line, columns count bytes
+// parsing resumes from the checkpoints inside a line, so scrolling through a long line only costs the visible columns
+Lines highlight_lines(const Language* language, const Input* input, Cache& cache, std::size_t first_line, std::size_t count, std::size_t first_column, std::size_t last_column, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+// encodes spans compactly, each span is a varint of its distance to the previous span shifted left by 4 and combined with its style, and a varint of its length
+// adjacent spans with the same style are merged, spans with styles that do not fit into 4 bits are dropped
+std::string encode_spans(const std::vector<Span>& spans);
+// returns false if the data is not a valid encoding or a span ends past size
+bool decode_spans(const StringView& data, std::vector<Span>& spans, std::size_t size = -1);
+// the bracket pairs and comment blocks that span several lines, sorted by their start
+// the index is updated to the end of the input first, after an edit only the input up to where parsing continues with the tail of the cache is parsed again
+// the index and the ranges are allocated from the global heap, they do not take a memory resource
+std::vector<FoldingRange> folding_ranges(const Language* language, const Input* input, Cache& cache, FoldingIndex& index);
+
+// only available if prism is built with PRISM_PROFILE, otherwise the profile is always empty
+std::vector<RuleProfile> get_profile();
+void reset_profile();
 
 }
@@ -0,0 +1,72 @@
+#include <prism.hpp>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+static const char* get_file_name(const char* path) {
+	const char* file_name = path;
+	for (const char* i = path; *i != '\0'; ++i) {
+		if (*i == '/') {
+			file_name = i + 1;
+		}
+	}
+	return file_name;
+}
+
+static std::vector<char> read_file(const char* path) {
+	std::ifstream file(path);
+	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static double to_milliseconds(std::chrono::nanoseconds time) {
+	return std::chrono::duration<double, std::milli>(time).count();
+}
+
+static void print_report(std::vector<RuleProfile> rules) {
+	std::sort(rules.begin(), rules.end(), [](const RuleProfile& rule0, const RuleProfile& rule1) {
+		return rule0.self_time > rule1.self_time;
+	});
+	std::cout << std::left << std::setw(32) << "rule"
+		<< std::right << std::setw(12) << "calls"
+		<< std::setw(10) << "success"
+		<< std::setw(14) << "backtracked"
+		<< std::setw(12) << "self ms"
+		<< std::setw(12) << "total ms" << '\n';
+	for (const RuleProfile& rule: rules) {
+		std::cout << std::left << std::setw(32) << rule.name
+			<< std::right << std::setw(12) << rule.invocations
+			<< std::setw(9) << std::fixed << std::setprecision(1) << 100.0 * rule.successes / rule.invocations << '%'
+			<< std::setw(14) << rule.backtracked_bytes
+			<< std::setw(12) << std::setprecision(3) << to_milliseconds(rule.self_time)
+			<< std::setw(12) << to_milliseconds(rule.total_time) << '\n';
+	}
+}
+
+int main(int argc, const char** argv) {
+	if (argc <= 1) {
+		std::cerr << "Usage: " << argv[0] << " FILE [ITERATIONS]\n";
+		return 1;
+	}
+	const char* path = argv[1];
+	const Language* language = prism::get_language(get_file_name(path));
+	if (language == nullptr) {
+		std::cerr << "prism does currently not support this language\n";
+		return 1;
+	}
+	const int iterations = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 1;
+	const auto file = read_file(path);
+	StringInput input(file.data(), file.size());
+	prism::reset_profile();
+	for (int i = 0; i < iterations; ++i) {
+		Cache cache;
+		prism::highlight(language, &input, cache, 0, file.size());
+	}
+	const std::vector<RuleProfile> rules = prism::get_profile();
+	if (rules.empty()) {
+		std::cerr << "no profile was recorded, prism needs to be built with PRISM_PROFILE\n";
+		return 1;
+	}
+	print_report(rules);
+}
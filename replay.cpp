@@ -0,0 +1,199 @@
+#include <prism.hpp>
+#include <vector>
+#include <string>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+
+// an input that is split into small chunks like the rope of an editor and records which chunks the parser touches
+class ChunkedInput final: public Input {
+	static constexpr std::size_t CHUNK_SIZE = 256;
+	const std::string& text;
+	mutable std::vector<bool> touched_chunks;
+	Chunk make_chunk(std::size_t index) const {
+		const std::size_t offset = index * CHUNK_SIZE;
+		if (offset >= text.size()) {
+			return {nullptr, nullptr, 0};
+		}
+		if (index >= touched_chunks.size()) {
+			touched_chunks.resize(index + 1);
+		}
+		touched_chunks[index] = true;
+		return {text.data() + offset, text.data() + offset, std::min(CHUNK_SIZE, text.size() - offset)};
+	}
+public:
+	ChunkedInput(const std::string& text): text(text) {}
+	std::pair<Chunk, std::size_t> get_chunk(std::size_t pos) const override {
+		const std::size_t index = pos / CHUNK_SIZE;
+		const Chunk chunk = make_chunk(index);
+		if (chunk.data == nullptr) {
+			return {{nullptr, nullptr, 0}, pos};
+		}
+		return {chunk, index * CHUNK_SIZE};
+	}
+	Chunk get_next_chunk(const void* chunk) const override {
+		return make_chunk((static_cast<const char*>(chunk) - text.data()) / CHUNK_SIZE + 1);
+	}
+	std::size_t get_touched_bytes() const {
+		std::size_t bytes = 0;
+		for (std::size_t i = 0; i < touched_chunks.size(); ++i) {
+			if (touched_chunks[i]) {
+				bytes += std::min(CHUNK_SIZE, text.size() - i * CHUNK_SIZE);
+			}
+		}
+		return bytes;
+	}
+	void reset_touched_chunks() {
+		touched_chunks.clear();
+	}
+};
+
+struct Edit {
+	std::size_t pos;
+	std::size_t deleted;
+	std::string inserted;
+};
+
+static const char* get_file_name(const char* path) {
+	const char* file_name = path;
+	for (const char* i = path; *i != '\0'; ++i) {
+		if (*i == '/') {
+			file_name = i + 1;
+		}
+	}
+	return file_name;
+}
+
+static std::string read_file(const char* path) {
+	std::ifstream file(path);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static std::string unescape(const std::string& s) {
+	std::string result;
+	for (std::size_t i = 0; i < s.size(); ++i) {
+		if (s[i] == '\\' && i + 1 < s.size()) {
+			++i;
+			result.push_back(s[i] == 'n' ? '\n' : s[i] == 't' ? '\t' : s[i] == 'r' ? '\r' : s[i] == 's' ? ' ' : s[i]);
+		}
+		else {
+			result.push_back(s[i]);
+		}
+	}
+	return result;
+}
+
+// one edit per line: "insert POS TEXT" with \n, \t, \r, \s and \\ escapes in TEXT, or "delete POS LENGTH"
+static std::vector<Edit> read_trace(const char* path) {
+	std::vector<Edit> edits;
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream stream(line);
+		std::string operation;
+		Edit edit = {0, 0, std::string()};
+		if (!(stream >> operation >> edit.pos)) {
+			continue;
+		}
+		if (operation == "insert") {
+			std::string text;
+			stream >> text;
+			edit.inserted = unescape(text);
+		}
+		else if (operation == "delete") {
+			stream >> edit.deleted;
+		}
+		else {
+			continue;
+		}
+		edits.push_back(edit);
+	}
+	return edits;
+}
+
+// simulates typing at a few random positions in the file
+static std::vector<Edit> generate_trace(std::size_t size, std::size_t count) {
+	static constexpr const char* characters = "abcxyz_019 (){};+=\"'/*\n";
+	std::vector<Edit> edits;
+	std::mt19937 random(42);
+	std::size_t cursor = 0;
+	for (std::size_t i = 0; i < count; ++i) {
+		if (i % 20 == 0) {
+			cursor = std::uniform_int_distribution<std::size_t>(0, size)(random);
+		}
+		if (cursor > 0 && random() % 8 == 0) {
+			--cursor;
+			edits.push_back({cursor, 1, std::string()});
+			--size;
+		}
+		else {
+			const char c = characters[random() % StringView::strlen(characters)];
+			edits.push_back({cursor, 0, std::string(1, c)});
+			++cursor;
+			++size;
+		}
+	}
+	return edits;
+}
+
+template <class T> static T get_percentile(std::vector<T> values, double percentile) {
+	std::sort(values.begin(), values.end());
+	return values[std::min(static_cast<std::size_t>(percentile * values.size()), values.size() - 1)];
+}
+
+int main(int argc, const char** argv) {
+	if (argc <= 1) {
+		std::cerr << "Usage: " << argv[0] << " FILE [TRACE] [VIEWPORT]\n";
+		return 1;
+	}
+	const char* path = argv[1];
+	const Language* language = prism::get_language(get_file_name(path));
+	if (language == nullptr) {
+		std::cerr << "prism does currently not support this language\n";
+		return 1;
+	}
+	std::string text = read_file(path);
+	const std::vector<Edit> edits = argc > 2 && StringView(argv[2]) != "-" ? read_trace(argv[2]) : generate_trace(text.size(), 1000);
+	const std::size_t viewport = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 4096;
+	ChunkedInput input(text);
+	Cache cache;
+	prism::highlight(language, &input, cache, 0, text.size());
+	std::vector<double> latencies;
+	std::vector<std::size_t> reparsed_bytes;
+	for (std::size_t i = 0; i < edits.size(); ++i) {
+		const Edit& edit = edits[i];
+		if (edit.pos > text.size() || edit.deleted > text.size() - edit.pos) {
+			std::cerr << "edit " << i << " is out of bounds\n";
+			return 1;
+		}
+		text.replace(edit.pos, edit.deleted, edit.inserted);
+		const std::size_t window_start = edit.pos - std::min(edit.pos, viewport / 2);
+		const std::size_t window_end = std::min(window_start + viewport, text.size());
+		input.reset_touched_chunks();
+		const auto start_time = std::chrono::steady_clock::now();
+		cache.edit(&input, edit.pos, edit.deleted, edit.inserted.size());
+		const std::vector<Span> spans = prism::highlight(language, &input, cache, window_start, window_end);
+		const auto end_time = std::chrono::steady_clock::now();
+		latencies.push_back(std::chrono::duration<double, std::micro>(end_time - start_time).count());
+		reparsed_bytes.push_back(input.get_touched_bytes());
+		const StringInput cold_input(text.data(), text.size());
+		Cache cold_cache;
+		if (spans != prism::highlight(language, &cold_input, cold_cache, window_start, window_end)) {
+			std::cerr << "edit " << i << " at " << edit.pos << ": spans differ from a cold highlight of " << window_start << ".." << window_end << '\n';
+			return 1;
+		}
+	}
+	if (edits.empty()) {
+		std::cerr << "the trace does not contain any edits\n";
+		return 1;
+	}
+	std::cout << "edits:          " << edits.size() << '\n';
+	std::cout << "latency p50:    " << get_percentile(latencies, 0.5) << " us\n";
+	std::cout << "latency p99:    " << get_percentile(latencies, 0.99) << " us\n";
+	std::cout << "latency max:    " << get_percentile(latencies, 1.0) << " us\n";
+	std::cout << "reparsed p50:   " << get_percentile(reparsed_bytes, 0.5) << " bytes\n";
+	std::cout << "reparsed p99:   " << get_percentile(reparsed_bytes, 0.99) << " bytes\n";
+	std::cout << "reparsed max:   " << get_percentile(reparsed_bytes, 1.0) << " bytes\n";
+}
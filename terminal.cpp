@@ -1,27 +1,178 @@
 #include <prism.hpp>
 #include <vector>
+#include <string>
 #include <cmath>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <thread>
 
-static void set_background_color(const Color& color) {
-	std::cout << "\e[48;2;"
-		<< std::round(color.r * 255) << ";"
-		<< std::round(color.g * 255) << ";"
-		<< std::round(color.b * 255) << "m";
+enum class ColorMode {
+	NONE,
+	ANSI16,
+	ANSI256,
+	TRUECOLOR
+};
+
+// returns false if the name is not a color mode
+static bool get_color_mode(const char* name, ColorMode& mode) {
+	const StringView name_view(name);
+	if (name_view == "truecolor") {
+		mode = ColorMode::TRUECOLOR;
+	}
+	else if (name_view == "256") {
+		mode = ColorMode::ANSI256;
+	}
+	else if (name_view == "16") {
+		mode = ColorMode::ANSI16;
+	}
+	else if (name_view == "none") {
+		mode = ColorMode::NONE;
+	}
+	else {
+		return false;
+	}
+	return true;
 }
-static void apply_style(const Style& style) {
-	std::cout << "\e[38;2;"
-		<< std::round(style.color.r * 255) << ";"
-		<< std::round(style.color.g * 255) << ";"
-		<< std::round(style.color.b * 255) << ";"
-		<< (style.bold ? 1 : 22) << ";"
-		<< (style.italic ? 3 : 23) << "m";
+
+static ColorMode detect_color_mode() {
+	const char* colorterm = std::getenv("COLORTERM");
+	if (colorterm && (StringView(colorterm) == "truecolor" || StringView(colorterm) == "24bit")) {
+		return ColorMode::TRUECOLOR;
+	}
+	const char* term = std::getenv("TERM");
+	if (term == nullptr || *term == '\0' || StringView(term) == "dumb") {
+		return ColorMode::NONE;
+	}
+	if (StringView(term).ends_with("256color")) {
+		return ColorMode::ANSI256;
+	}
+	return ColorMode::ANSI16;
 }
-static void clear_style() {
-	std::cout << "\e[m";
+
+struct RGB {
+	int r;
+	int g;
+	int b;
+	RGB(int r, int g, int b): r(r), g(g), b(b) {}
+	RGB(const Color& color): r(std::round(color.r * 255)), g(std::round(color.g * 255)), b(std::round(color.b * 255)) {}
+	int distance(const RGB& rgb) const {
+		return (r - rgb.r) * (r - rgb.r) + (g - rgb.g) * (g - rgb.g) + (b - rgb.b) * (b - rgb.b);
+	}
+};
+
+static int get_ansi16_color(const RGB& rgb) {
+	const int max = std::max(std::max(rgb.r, rgb.g), rgb.b);
+	const int min = std::min(std::min(rgb.r, rgb.g), rgb.b);
+	// colors with a low saturation are mapped to black, gray or white
+	if ((max - min) * 4 < max || max == 0) {
+		return max < 64 ? 0 : max < 128 ? 8 : max < 217 ? 7 : 15;
+	}
+	// otherwise the nearest hue of red, yellow, green, cyan, blue and magenta is used
+	const float delta = max - min;
+	float hue = max == rgb.r ? 60.f * (rgb.g - rgb.b) / delta : max == rgb.g ? 120.f + 60.f * (rgb.b - rgb.r) / delta : 240.f + 60.f * (rgb.r - rgb.g) / delta;
+	if (hue < 0.f) {
+		hue += 360.f;
+	}
+	static constexpr int hues[6] = {1, 3, 2, 6, 4, 5};
+	return hues[static_cast<int>((hue + 30.f) / 60.f) % 6] + (max > 204 ? 8 : 0);
+}
+
+static int get_ansi256_color(const RGB& rgb) {
+	// the nearest color of the 6x6x6 cube and of the grayscale ramp
+	static constexpr int levels[6] = {0, 95, 135, 175, 215, 255};
+	auto get_level = [](int value) {
+		int result = 0;
+		for (int i = 1; i < 6; ++i) {
+			if (std::abs(value - levels[i]) < std::abs(value - levels[result])) {
+				result = i;
+			}
+		}
+		return result;
+	};
+	const int r = get_level(rgb.r);
+	const int g = get_level(rgb.g);
+	const int b = get_level(rgb.b);
+	const int gray = std::min(std::max((rgb.r + rgb.g + rgb.b) / 3 - 8 + 5, 0) / 10, 23);
+	const int gray_value = 8 + gray * 10;
+	if (rgb.distance(RGB(gray_value, gray_value, gray_value)) < rgb.distance(RGB(levels[r], levels[g], levels[b]))) {
+		return 232 + gray;
+	}
+	return 16 + 36 * r + 6 * g + b;
+}
+
+// the SGR parameters of a color, quantized to the color mode
+static std::string get_color_parameters(const Color& color, ColorMode mode, bool background) {
+	const RGB rgb(color);
+	switch (mode) {
+	case ColorMode::TRUECOLOR:
+		return (background ? "48;2;" : "38;2;") + std::to_string(rgb.r) + ";" + std::to_string(rgb.g) + ";" + std::to_string(rgb.b);
+	case ColorMode::ANSI256:
+		return (background ? "48;5;" : "38;5;") + std::to_string(get_ansi256_color(rgb));
+	case ColorMode::ANSI16: {
+		const int index = get_ansi16_color(rgb);
+		return std::to_string((index < 8 ? 30 : 90) + (background ? 10 : 0) + index % 8);
+	}
+	default:
+		return std::string();
+	}
 }
 
+// the escape sequences of a theme are computed once and only the attributes that change between two styles are emitted
+class StyleWriter {
+	struct TerminalStyle {
+		std::string foreground;
+		bool bold;
+		bool italic;
+	};
+	ColorMode mode;
+	std::string background;
+	TerminalStyle styles[11];
+	const TerminalStyle* current_style;
+	std::string sequence;
+	void add_parameter(const std::string& parameter) {
+		sequence += sequence.empty() ? "\e[" : ";";
+		sequence += parameter;
+	}
+public:
+	StyleWriter(const Theme& theme, ColorMode mode): mode(mode), background(get_color_parameters(theme.background, mode, true)), current_style(nullptr) {
+		for (int i = 0; i < 11; ++i) {
+			styles[i] = {get_color_parameters(theme.styles[i].color, mode, false), theme.styles[i].bold, theme.styles[i].italic};
+		}
+	}
+	void set_background() {
+		if (mode != ColorMode::NONE) {
+			std::cout << "\e[" << background << "m";
+		}
+	}
+	void apply_style(int style) {
+		const TerminalStyle* new_style = &styles[style - Style::DEFAULT];
+		if (mode == ColorMode::NONE || new_style == current_style) {
+			return;
+		}
+		sequence.clear();
+		if (current_style == nullptr || new_style->foreground != current_style->foreground) {
+			add_parameter(new_style->foreground);
+		}
+		if (current_style == nullptr ? new_style->bold : new_style->bold != current_style->bold) {
+			add_parameter(new_style->bold ? "1" : "22");
+		}
+		if (current_style == nullptr ? new_style->italic : new_style->italic != current_style->italic) {
+			add_parameter(new_style->italic ? "3" : "23");
+		}
+		if (!sequence.empty()) {
+			std::cout << sequence << "m";
+		}
+		current_style = new_style;
+	}
+	void clear_style() {
+		if (mode != ColorMode::NONE) {
+			std::cout << "\e[m";
+		}
+		current_style = nullptr;
+	}
+};
+
 static const char* get_file_name(const char* path) {
 	const char* file_name = path;
 	for (const char* i = path; *i != '\0'; ++i) {
@@ -37,60 +188,233 @@ static std::vector<char> read_file(const char* path) {
 	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
 }
 
-template <class T> static void print(const T& file, const std::vector<Span>& spans, const Theme& theme, std::size_t window_start, std::size_t window_end) {
+static void write(const Input* input, std::size_t start, std::size_t end) {
+	auto chunk_pair = input->get_chunk(start);
+	Input::Chunk chunk = chunk_pair.first;
+	std::size_t offset = chunk_pair.second;
+	while (start < end && chunk.size > 0) {
+		const std::size_t size = std::min(end, offset + chunk.size) - start;
+		std::cout.write(chunk.data + (start - offset), size);
+		start += size;
+		offset += chunk.size;
+		chunk = input->get_next_chunk(chunk.chunk);
+	}
+}
+
+static void print(const Input* input, const std::vector<Span>& spans, StyleWriter& writer, std::size_t window_start, std::size_t window_end) {
 	std::size_t i = window_start;
 	for (const Span& span: spans) {
+		if (span.start >= window_end) {
+			break;
+		}
 		if (span.start > i) {
-			apply_style(theme.styles[0]);
-			std::cout.write(file.data() + i, span.start - i);
+			writer.apply_style(Style::DEFAULT);
+			write(input, i, span.start);
 		}
-		apply_style(theme.styles[span.style - Style::DEFAULT]);
-		std::cout.write(file.data() + span.start, span.end - span.start);
-		i = span.end;
+		writer.apply_style(span.style);
+		write(input, span.start, std::min(span.end, window_end));
+		i = std::min(span.end, window_end);
 	}
 	if (window_end > i) {
-		apply_style(theme.styles[0]);
-		std::cout.write(file.data() + i, window_end - i);
+		writer.apply_style(Style::DEFAULT);
+		write(input, i, window_end);
 	}
 }
 
-static void highlight(const char* path, const Language* language, const Theme& theme) {
-	const auto file = read_file(path);
+// files that have been highlighted before are not parsed again
+static void highlight_stored(const std::vector<char>& file, const Language* language, StyleWriter& writer, const char* store_directory) {
 	StringInput input(file.data(), file.size());
-	Cache cache;
-	std::vector<Span> spans = prism::highlight(language, &input, cache, 0, file.size());
-	set_background_color(theme.background);
+	const std::vector<Span> spans = SpanStore(store_directory).highlight(language, &input);
+	writer.set_background();
 	std::cout << '\n';
-	print(file, spans, theme, 0, file.size());
-	clear_style();
+	print(&input, spans, writer, 0, file.size());
+	writer.clear_style();
 	std::cout << '\n';
 }
 
-static void highlight_incremental(const char* path, const Language* language, const Theme& theme) {
-	const auto file = read_file(path);
+// parses on a second thread while the spans that have been committed so far are printed
+static void highlight_pipelined(const std::vector<char>& file, const Language* language, StyleWriter& writer) {
+	StringInput input(file.data(), file.size());
+	SpanQueue queue;
+	std::thread parser([&]() {
+		Cache cache;
+		prism::highlight_stream(language, &input, cache, queue);
+		queue.close();
+	});
+	writer.set_background();
+	std::cout << '\n';
+	constexpr std::size_t BATCH_SIZE = 256;
+	std::vector<Span> spans(BATCH_SIZE);
+	std::size_t printed = 0;
+	while (const std::size_t size = queue.get_spans(spans.data(), BATCH_SIZE)) {
+		spans.resize(size);
+		print(&input, spans, writer, printed, spans.back().end);
+		printed = spans.back().end;
+		spans.resize(BATCH_SIZE);
+	}
+	parser.join();
+	print(&input, {}, writer, printed, file.size());
+	writer.clear_style();
+	std::cout << '\n';
+}
+
+static void highlight_incremental(const std::vector<char>& file, const Language* language, StyleWriter& writer) {
 	StringInput input(file.data(), file.size());
 	Cache cache;
-	set_background_color(theme.background);
+	writer.set_background();
 	std::cout << '\n';
 	for (std::size_t i = 0; i < file.size(); i += 1000) {
 		std::vector<Span> spans = prism::highlight(language, &input, cache, i, std::min(i + 1000, file.size()));
-		print(file, spans, theme, i, std::min(i + 1000, file.size()));
+		print(&input, spans, writer, i, std::min(i + 1000, file.size()));
+	}
+	writer.clear_style();
+	std::cout << '\n';
+}
+
+static bool is_blank(const std::string& line) {
+	return line.find_first_not_of(" \t\r\n") == std::string::npos;
+}
+
+// highlights standard input line by line as it arrives
+// text is printed once the outermost parse has a checkpoint behind it that does not depend on the end of the input,
+// so its colors are final, e.g. an unterminated comment is held back until it ends or more than MAX_PENDING bytes are waiting
+// only the checkpoints and the input that are needed to continue are kept
+static bool highlight_stdin(const Language* language, StyleWriter& writer) {
+	constexpr std::size_t MAX_PENDING = 64 * 1024;
+	// an open token is parsed again from its start for every line, so once this much is pending it is only parsed again when the pending text has doubled
+	constexpr std::size_t MIN_BACKOFF = 4 * 1024;
+	// without a language the input is buffered until its content identifies one
+	constexpr std::size_t MAX_DETECTION = 64 * 1024;
+	AppendableInput input;
+	Cache cache;
+	std::string line;
+	std::size_t printed = 0;
+	std::size_t next_attempt = 0;
+	bool restart = false;
+	writer.set_background();
+	std::cout << '\n';
+	while (std::getline(std::cin, line)) {
+		if (!std::cin.eof()) {
+			line.push_back('\n');
+		}
+		if (restart) {
+			// the pending text was printed without waiting for its token to end, parsing starts again after it
+			// so that the unfinished token is not parsed again for every line
+			cache.restart(printed);
+			restart = false;
+		}
+		else {
+			// checkpoints that looked at the previous end of the input are outdated
+			cache.invalidate(input.size());
+		}
+		input.append(line.data(), line.size());
+		if (language == nullptr) {
+			// whitespace does not change the result of the detection
+			if (!is_blank(line)) {
+				language = prism::get_language("", &input);
+			}
+			if (language == nullptr) {
+				if (input.size() >= MAX_DETECTION) {
+					break;
+				}
+				continue;
+			}
+		}
+		const std::size_t end = input.size();
+		if (end - printed > MIN_BACKOFF && end - printed < next_attempt && end - printed <= MAX_PENDING) {
+			continue;
+		}
+		const std::vector<Span> spans = prism::highlight(language, &input, cache, printed, end);
+		restart = end - printed > MAX_PENDING;
+		const std::size_t stable = restart ? end : std::max(cache.get_restart_pos(end, end), printed);
+		print(&input, spans, writer, printed, stable);
+		std::cout.flush();
+		printed = stable;
+		next_attempt = 2 * (end - printed);
+		if (restart) {
+			input.release(printed);
+			continue;
+		}
+		cache.prune(printed, 1024 * 1024);
+		input.release(cache.get_restart_pos(printed, end));
+	}
+	if (language == nullptr) {
+		writer.clear_style();
+		return false;
 	}
-	clear_style();
+	// the rest is printed with the colors it has at the end of the input
+	if (printed < input.size()) {
+		const std::vector<Span> spans = prism::highlight(language, &input, cache, printed, input.size());
+		print(&input, spans, writer, printed, input.size());
+	}
+	writer.clear_style();
 	std::cout << '\n';
+	return true;
+}
+
+static void print_usage(const char* program) {
+	std::cerr << "Usage: " << program << " [--color=truecolor|256|16|none] [--language=EXTENSION] [--store=DIRECTORY] [FILE|-] [THEME]\n";
 }
 
 int main(int argc, const char** argv) {
-	if (argc <= 1) {
-		std::cerr << "Usage: " << argv[0] << " FILE [THEME]\n";
-		return 1;
+	ColorMode mode = detect_color_mode();
+	const char* language_name = nullptr;
+	const char* store_directory = nullptr;
+	std::vector<const char*> arguments;
+	for (int i = 1; i < argc; ++i) {
+		if (StringView(argv[i]).starts_with("--color=")) {
+			if (!get_color_mode(argv[i] + StringView::strlen("--color="), mode)) {
+				std::cerr << "unknown color mode " << argv[i] + StringView::strlen("--color=") << '\n';
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if (StringView(argv[i]).starts_with("--language=")) {
+			language_name = argv[i] + StringView::strlen("--language=");
+		}
+		else if (StringView(argv[i]).starts_with("--store=")) {
+			store_directory = argv[i] + StringView::strlen("--store=");
+		}
+		else if (StringView(argv[i]) == "--help") {
+			print_usage(argv[0]);
+			return 1;
+		}
+		else {
+			arguments.push_back(argv[i]);
+		}
+	}
+	// the language flag takes a file extension like json
+	const Language* language = nullptr;
+	if (language_name) {
+		language = prism::get_language((std::string("file.") + language_name).c_str());
+		if (language == nullptr) {
+			std::cerr << "prism does currently not support this language\n";
+			return 1;
+		}
+	}
+	const char* path = arguments.empty() ? "-" : arguments[0];
+	const Theme& theme = prism::get_theme(arguments.size() > 1 ? arguments[1] : "one-dark");
+	StyleWriter writer(theme, mode);
+	if (StringView(path) == "-") {
+		if (!highlight_stdin(language, writer)) {
+			std::cerr << "\nthe language could not be detected, use --language\n";
+			return 1;
+		}
+		return 0;
+	}
+	const auto file = read_file(path);
+	const StringInput input(file.data(), file.size());
+	if (language == nullptr) {
+		language = prism::get_language(get_file_name(path), &input);
 	}
-	const char* path = argv[1];
-	const Language* language = prism::get_language(get_file_name(path));
 	if (language == nullptr) {
 		std::cerr << "prism does currently not support this language\n";
 		return 1;
 	}
-	const Theme& theme = prism::get_theme(argc > 2 ? argv[2] : "one-dark");
-	highlight(path, language, theme);
+	if (store_directory) {
+		highlight_stored(file, language, writer, store_directory);
+	}
+	else {
+		highlight_pipelined(file, language, writer);
+	}
 }
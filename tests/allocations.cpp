@@ -0,0 +1,126 @@
+#include <prism.hpp>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <new>
+
+// counts the allocations from the global heap
+static std::size_t allocations = 0;
+void* operator new(std::size_t size) {
+	++allocations;
+	if (void* p = std::malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+// std::pmr::new_delete_resource allocates with the aligned operator new
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	++allocations;
+	if (void* p = std::aligned_alloc(static_cast<std::size_t>(alignment), (size + static_cast<std::size_t>(alignment) - 1) / static_cast<std::size_t>(alignment) * static_cast<std::size_t>(alignment))) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+void operator delete(void* p, std::align_val_t) noexcept {
+	std::free(p);
+}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+	std::free(p);
+}
+
+static char buffer[16 * 1024 * 1024];
+
+// re-highlighting windows that are already cached allocates only from the given memory resource
+static bool check(const char* name, const Language* language, const std::string& text) {
+	const StringInput input(text.data(), text.size());
+	std::pmr::unsynchronized_pool_resource pool;
+	Cache cache(&pool);
+	const std::vector<Span> expected = prism::highlight(language, &input, cache, 0, text.size());
+	bool success = true;
+	const auto fail = [&](const char* function, std::size_t window_start, std::size_t count) {
+		std::cerr << name << ": " << function << " at " << window_start << " made " << count << " allocations\n";
+		success = false;
+	};
+	for (std::size_t window_start = 0; window_start < text.size(); window_start += text.size() / 7 + 1) {
+		const std::size_t window_end = std::min(text.size(), window_start + 4096);
+		// the first highlight of a window may still index lines or add checkpoints to the cache
+		prism::highlight_lines(language, &input, cache, cache.get_line(&input, window_start), 16);
+		{
+			std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+			const std::size_t before = allocations;
+			const std::pmr::vector<Span> spans = prism::highlight(language, &input, cache, window_start, window_end, &arena);
+			if (allocations != before) {
+				fail("highlight", window_start, allocations - before);
+			}
+			if (std::vector<Span>(spans.begin(), spans.end()) != prism::highlight(language, &input, cache, window_start, window_end)) {
+				std::cerr << name << ": the spans at " << window_start << " differ\n";
+				success = false;
+			}
+		}
+		{
+			std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+			const std::size_t before = allocations;
+			prism::highlight(language, &input, cache, window_start, window_end, Budget(), &arena);
+			if (allocations != before) {
+				fail("highlight with a budget", window_start, allocations - before);
+			}
+		}
+		{
+			const std::size_t line = cache.get_line(&input, window_start);
+			std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+			const std::size_t before = allocations;
+			prism::highlight_lines(language, &input, cache, line, 16, &arena);
+			prism::highlight_lines(language, &input, cache, line, 16, 8, 40, &arena);
+			if (allocations != before) {
+				fail("highlight_lines", window_start, allocations - before);
+			}
+		}
+	}
+	std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+	const std::size_t before = allocations;
+	const std::pmr::vector<Span> spans = prism::highlight(language, &input, cache, 0, text.size(), &arena);
+	if (allocations != before) {
+		fail("highlight", 0, allocations - before);
+	}
+	if (std::vector<Span>(spans.begin(), spans.end()) != expected) {
+		std::cerr << name << ": the spans of the whole input differ\n";
+		success = false;
+	}
+	return success;
+}
+
+int main(int argc, char** argv) {
+	if (argc != 2) {
+		std::cerr << "Usage: " << argv[0] << " DIRECTORY\n";
+		return 1;
+	}
+	bool success = true;
+	for (const char* file_name: {"test.c", "test.hs", "test.java", "test.js", "test.py", "test.rs"}) {
+		std::ifstream file(std::string(argv[1]) + '/' + file_name);
+		std::stringstream content;
+		content << file.rdbuf();
+		std::string text;
+		// large enough for checkpoints in every window
+		for (int i = 0; i < 40; ++i) {
+			text += content.str();
+		}
+		success = check(file_name, prism::get_language(file_name), text) && success;
+	}
+	std::string json;
+	std::string xml;
+	for (int i = 0; i < 2000; ++i) {
+		json += "{\"key\": [1, -2.5e3, true, null, \"value \\n\\u00e4\"]},\n";
+		xml += "<item id=\"1\"><!-- comment --><![CDATA[data]]>text &amp; more</item>\n";
+	}
+	success = check("JSON", prism::get_language("test.json"), "[" + json + "0]") && success;
+	success = check("XML", prism::get_language("test.xml"), xml) && success;
+	return success ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+#include <prism.hpp>
+#include <string>
+#include <random>
+#include <iostream>
+
+// counts the chunks that are requested, each one is 64 bytes
+class CountingInput final: public Input {
+	static constexpr std::size_t CHUNK_SIZE = 64;
+	const std::string& text;
+public:
+	mutable std::size_t chunks = 0;
+	CountingInput(const std::string& text): text(text) {}
+	std::pair<Chunk, std::size_t> get_chunk(std::size_t pos) const override {
+		const std::size_t offset = std::min(pos, text.size()) / CHUNK_SIZE * CHUNK_SIZE;
+		++chunks;
+		return {{reinterpret_cast<const void*>(offset), text.data() + offset, std::min(CHUNK_SIZE, text.size() - offset)}, offset};
+	}
+	Chunk get_next_chunk(const void* chunk) const override {
+		const std::size_t offset = reinterpret_cast<std::size_t>(chunk) + CHUNK_SIZE;
+		if (offset >= text.size()) {
+			return {nullptr, nullptr, 0};
+		}
+		++chunks;
+		return {reinterpret_cast<const void*>(offset), text.data() + offset, std::min(CHUNK_SIZE, text.size() - offset)};
+	}
+};
+
+static bool check(bool condition, const char* message) {
+	if (!condition) {
+		std::cerr << message << '\n';
+	}
+	return condition;
+}
+
+// the brackets are the same as those of an index that is built up to end from scratch
+static bool brackets_match(const std::string& text, const BracketIndex& index, std::size_t end) {
+	const StringInput input(text.data(), text.size());
+	Cache cache;
+	BracketIndex fresh;
+	fresh.update(&prism::languages::c, &input, cache, end);
+	const std::vector<BracketIndex::Bracket>& a = index.get_brackets();
+	const std::vector<BracketIndex::Bracket>& b = fresh.get_brackets();
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		if (a[i].pos != b[i].pos || a[i].c != b[i].c || a[i].depth != b[i].depth || a[i].match != b[i].match || a[i].parent != b[i].parent) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main() {
+	bool success = true;
+	{
+		// random edits, the index is only updated as far as a window needs it and the cache is also used for other windows
+		const char* pieces[] = {"(", ")", "[", "]", "{", "}", "/*", "*/", "\"", "'", "//", "\n", "f(x[1]);", "if (a) { b(); }"};
+		std::mt19937 random(1);
+		for (int seed = 0; seed < 60; ++seed) {
+			std::string text;
+			for (int i = 0; i < 20; ++i) {
+				text += "int f(int a[4]) {\n\t/* (comment) */ return g(a[0], \"{\");\n}\n";
+			}
+			Cache cache;
+			BracketIndex index;
+			for (int i = 0; i < 30; ++i) {
+				const StringInput input(text.data(), text.size());
+				const std::size_t end = random() % 2 ? text.size() : random() % (text.size() + 1);
+				index.update(&prism::languages::c, &input, cache, end);
+				if (!brackets_match(text, index, index.get_end())) {
+					std::cerr << "seed " << seed << ", edit " << i << ": ";
+					success = check(false, "the index after an edit differs from a new index") && success;
+					break;
+				}
+				if (random() % 2) {
+					const std::size_t window_start = random() % (text.size() + 1);
+					prism::highlight(&prism::languages::c, &input, cache, window_start, std::min(text.size(), window_start + 100));
+				}
+				const std::size_t pos = random() % (text.size() + 1);
+				const std::size_t deleted = std::min<std::size_t>(random() % 4, text.size() - pos);
+				const std::string inserted = random() % 2 ? pieces[random() % (sizeof(pieces) / sizeof(pieces[0]))] : "";
+				text.replace(pos, deleted, inserted);
+				const StringInput edited_input(text.data(), text.size());
+				cache.edit(&edited_input, pos, deleted, inserted.size());
+				index.edit(cache, pos, deleted, inserted.size());
+			}
+		}
+	}
+	{
+		// an edit near the start only rescans the input up to where parsing continues with the checkpoints behind it
+		std::string text;
+		for (int i = 0; i < 20000; ++i) {
+			text += "if (a[i]) { f(b, \"(\"); }\n";
+		}
+		Cache cache;
+		BracketIndex index;
+		{
+			const StringInput input(text.data(), text.size());
+			index.update(&prism::languages::c, &input, cache, -1);
+		}
+		const std::size_t pos = text.find("f(b", 100);
+		text.insert(pos, "g(x) + ");
+		CountingInput input(text);
+		cache.edit(&input, pos, 0, 7);
+		index.edit(cache, pos, 0, 7);
+		input.chunks = 0;
+		index.update(&prism::languages::c, &input, cache, -1);
+		success = check(input.chunks < 200, "the update after an edit read the input behind it") && success;
+		success = check(index.get_end() == text.size(), "the update after an edit did not index the whole input") && success;
+		success = check(brackets_match(text, index, text.size()), "the index after an edit near the start differs from a new index") && success;
+	}
+	{
+		// a comment that is opened and closed again before parsing continues with the checkpoints behind it
+		std::string text;
+		for (int i = 0; i < 20000; ++i) {
+			text += "if (a[i]) { f(b, \"(\"); }\n";
+		}
+		Cache cache;
+		BracketIndex index;
+		{
+			const StringInput input(text.data(), text.size());
+			index.update(&prism::languages::c, &input, cache, -1);
+		}
+		const std::size_t pos = text.find("f(b", 100);
+		text.insert(pos, "/*");
+		{
+			const StringInput input(text.data(), text.size());
+			cache.edit(&input, pos, 0, 2);
+			index.edit(cache, pos, 0, 2);
+			index.update(&prism::languages::c, &input, cache, -1);
+		}
+		text.erase(pos, 2);
+		CountingInput input(text);
+		cache.edit(&input, pos, 2, 0);
+		index.edit(cache, pos, 2, 0);
+		input.chunks = 0;
+		index.update(&prism::languages::c, &input, cache, -1);
+		success = check(input.chunks < 200, "the update after closing a comment read the input behind it") && success;
+		success = check(brackets_match(text, index, text.size()), "the index after closing a comment differs from a new index") && success;
+	}
+	return success ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#include <prism.hpp>
+#include <string>
+#include <random>
+#include <iostream>
+
+static bool check(bool condition, const char* message) {
+	if (!condition) {
+		std::cerr << message << '\n';
+	}
+	return condition;
+}
+
+static bool spans_equal(const std::vector<Span>& a, const std::vector<Span>& b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		if (a[i].start != b[i].start || a[i].end != b[i].end || a[i].style != b[i].style) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main() {
+	bool success = true;
+	constexpr std::size_t DOCUMENTS = 8;
+	std::vector<std::string> texts(DOCUMENTS);
+	for (std::size_t document = 0; document < DOCUMENTS; ++document) {
+		for (std::size_t i = 0; i < 60; ++i) {
+			texts[document] += "int f" + std::to_string(document * 100 + i) + "(int a) {\n\t/* comment */ return g(a, \"b\", 0x1F);\n}\n";
+		}
+	}
+	// a budget that holds the caches of about three documents
+	std::size_t document_size;
+	{
+		const StringInput input(texts[0].data(), texts[0].size());
+		Cache cache;
+		prism::highlight(&prism::languages::c, &input, cache, 0, texts[0].size());
+		document_size = cache.get_size();
+	}
+	std::size_t budget = 3 * document_size;
+	CacheManager manager(budget);
+	std::mt19937 random(1);
+	bool within_budget = true;
+	bool spans_match = true;
+	for (std::size_t i = 0; i < 300; ++i) {
+		const std::size_t document = random() % DOCUMENTS;
+		std::string& text = texts[document];
+		const StringInput input(text.data(), text.size());
+		switch (random() % 8) {
+		case 0: {
+			// edits are passed on to the cache of the document
+			const std::size_t pos = random() % (text.size() + 1);
+			const std::size_t deleted = std::min<std::size_t>(random() % 8, text.size() - pos);
+			const std::string inserted = random() % 2 ? "/* x */" : "\"";
+			text.replace(pos, deleted, inserted);
+			const StringInput edited_input(text.data(), text.size());
+			manager.edit(document, &edited_input, pos, deleted, inserted.size());
+			break;
+		}
+		case 1:
+			// a smaller budget thins and evicts caches at once, a larger one lets them grow again
+			budget = (random() % 4 + 2) * document_size;
+			manager.set_budget(budget);
+			break;
+		default: {
+			const std::size_t window_start = random() % (text.size() + 1);
+			const std::size_t window_end = std::min(text.size(), window_start + random() % 2000);
+			const std::vector<Span> spans = manager.highlight(document, &prism::languages::c, &input, window_start, window_end);
+			Cache cache;
+			spans_match = spans_match && spans_equal(spans, prism::highlight(&prism::languages::c, &input, cache, window_start, window_end));
+			break;
+		}
+		}
+		within_budget = within_budget && manager.get_size() <= budget;
+	}
+	success = check(spans_match, "the spans of a thinned or evicted cache differ from those of a new cache") && success;
+	success = check(within_budget, "the caches exceeded the budget") && success;
+	for (std::size_t document = 0; document < DOCUMENTS; ++document) {
+		manager.remove(document);
+	}
+	success = check(manager.get_size() == 0, "the size of the caches was not accounted correctly") && success;
+	{
+		// the most recently used cache is kept even if it alone exceeds the budget
+		CacheManager small_manager(1);
+		const StringInput input(texts[0].data(), texts[0].size());
+		small_manager.highlight(0, &prism::languages::c, &input, 0, texts[0].size());
+		success = check(small_manager.get_size() > 0, "the most recently used cache was evicted") && success;
+		const StringInput other_input(texts[1].data(), texts[1].size());
+		small_manager.highlight(1, &prism::languages::c, &other_input, 0, texts[1].size());
+		Cache cache;
+		prism::highlight(&prism::languages::c, &other_input, cache, 0, texts[1].size());
+		success = check(small_manager.get_size() <= cache.get_size(), "the least recently used cache was not evicted") && success;
+	}
+	return success ? 0 : 1;
+}
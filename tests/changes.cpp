@@ -0,0 +1,83 @@
+#include <prism.hpp>
+#include <string>
+#include <random>
+#include <iostream>
+
+static bool check(bool condition, const char* message) {
+	if (!condition) {
+		std::cerr << message << '\n';
+	}
+	return condition;
+}
+
+// the style of every byte and whether it is known, the model that ChangeTracker is compared with
+struct Byte {
+	int style;
+	bool known;
+};
+
+int main() {
+	bool success = true;
+	const char* pieces[] = {"/*", "*/", "\"", "//", "\n", "int", "x", "0x1F", "f(a);"};
+	std::mt19937 random(1);
+	for (int seed = 0; seed < 40; ++seed) {
+		std::string text;
+		for (int i = 0; i < 20; ++i) {
+			text += "int f(int a) {\n\t/* comment */ return g(a, \"b\", 0x1F);\n}\n";
+		}
+		std::vector<Byte> bytes(text.size(), {Style::DEFAULT, false});
+		ChangeTracker tracker;
+		Cache cache;
+		for (int i = 0; i < 30; ++i) {
+			const StringInput input(text.data(), text.size());
+			const std::size_t window_start = random() % (text.size() + 1);
+			const std::size_t window_end = std::min(text.size(), window_start + random() % 600);
+			const std::vector<Span> spans = prism::highlight(&prism::languages::c, &input, cache, window_start, window_end);
+			const std::vector<Range> changed_ranges = tracker.update(spans, window_start, window_end);
+			// the bytes of the window whose style differs from before or was not known, in maximal runs
+			std::vector<int> styles(window_end - window_start, Style::DEFAULT);
+			for (const Span& span: spans) {
+				for (std::size_t pos = span.start; pos < span.end; ++pos) {
+					styles[pos - window_start] = span.style;
+				}
+			}
+			std::vector<Range> expected;
+			for (std::size_t pos = window_start; pos < window_end; ++pos) {
+				if (bytes[pos].known && bytes[pos].style == styles[pos - window_start]) {
+					continue;
+				}
+				if (!expected.empty() && expected.back().end == pos) {
+					expected.back().end = pos + 1;
+				}
+				else {
+					expected.emplace_back(pos, pos + 1);
+				}
+			}
+			// only the window of the last update is known
+			for (std::size_t pos = 0; pos < text.size(); ++pos) {
+				bytes[pos].known = pos >= window_start && pos < window_end;
+				bytes[pos].style = bytes[pos].known ? styles[pos - window_start] : Style::DEFAULT;
+			}
+			bool ranges_match = changed_ranges.size() == expected.size();
+			for (std::size_t j = 0; ranges_match && j < expected.size(); ++j) {
+				ranges_match = changed_ranges[j].start == expected[j].start && changed_ranges[j].end == expected[j].end;
+			}
+			if (!ranges_match) {
+				std::cerr << "seed " << seed << ", update " << i << ": ";
+				success = check(false, "the changed ranges differ from a comparison of every byte") && success;
+				break;
+			}
+			// inserted bytes are not known
+			const std::size_t pos = random() % (text.size() + 1);
+			const std::size_t deleted = std::min<std::size_t>(random() % 4, text.size() - pos);
+			const std::string inserted = random() % 2 ? pieces[random() % (sizeof(pieces) / sizeof(pieces[0]))] : "";
+			text.replace(pos, deleted, inserted);
+			bytes.erase(bytes.begin() + pos, bytes.begin() + pos + deleted);
+			bytes.insert(bytes.begin() + pos, inserted.size(), {Style::DEFAULT, false});
+			const StringInput edited_input(text.data(), text.size());
+			cache.edit(&edited_input, pos, deleted, inserted.size());
+			tracker.edit(pos, deleted, inserted.size());
+		}
+	}
+	return success ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+#include <prism.hpp>
+#include <string>
+#include <random>
+#include <iostream>
+
+static bool check(bool condition, const char* message) {
+	if (!condition) {
+		std::cerr << message << '\n';
+	}
+	return condition;
+}
+
+// a window highlighted with a cache that was updated for the edits has the same spans as with a new cache
+static bool highlight_matches(const std::string& text, Cache& cache, std::size_t window_start, std::size_t window_end) {
+	const StringInput input(text.data(), text.size());
+	Cache fresh;
+	return prism::highlight(&prism::languages::xml, &input, cache, window_start, window_end) == prism::highlight(&prism::languages::xml, &input, fresh, window_start, window_end);
+}
+
+int main() {
+	bool success = true;
+	{
+		// breaking the end delimiter of a region makes the region end at the next delimiter, the comment continues into it
+		std::string text = "<svg><script>\nvar a = 1; /* open comment\n</script>\n<g>'quoted' text</g>\n<script>\n*/ var b = 2;\n</script></svg>";
+		Cache cache;
+		{
+			const StringInput input(text.data(), text.size());
+			prism::highlight(&prism::languages::xml, &input, cache, 0, text.size());
+		}
+		const std::size_t pos = text.find("</script>") + 7;
+		text.insert(pos, "}");
+		cache.invalidate(pos);
+		const std::size_t line_start = text.find("<g>");
+		success = check(highlight_matches(text, cache, line_start, text.find('\n', line_start)), "the region kept its state after its end delimiter was broken") && success;
+	}
+	{
+		// random edits of an SVG with scripts
+		const char* pieces[] = {"<script>", "</script>", "/*", "*/", "'", "\"", "<g>", "</g>", "var x = 1;", "\n", "}", "<!--", "-->"};
+		std::mt19937 random(1);
+		for (int seed = 0; seed < 200; ++seed) {
+			std::string text = "<svg>\n";
+			for (int i = 0; i < 8; ++i) {
+				text += "<script>\nvar a = 'text'; /* comment */ f(1);\n</script>\n<g fill=\"red\">text</g>\n";
+			}
+			text += "</svg>\n";
+			Cache cache;
+			for (int i = 0; i < 30; ++i) {
+				const StringInput input(text.data(), text.size());
+				prism::highlight(&prism::languages::xml, &input, cache, 0, text.size());
+				const std::size_t pos = random() % text.size();
+				const std::size_t deleted = std::min<std::size_t>(random() % 4, text.size() - pos);
+				const std::string inserted = random() % 2 ? pieces[random() % (sizeof(pieces) / sizeof(pieces[0]))] : "";
+				text.replace(pos, deleted, inserted);
+				const StringInput edited_input(text.data(), text.size());
+				cache.edit(&edited_input, pos, deleted, inserted.size());
+				// a window after the edit resumes from the checkpoints that survived it
+				const std::size_t window_start = std::min(text.size(), pos + random() % 200);
+				if (!highlight_matches(text, cache, window_start, std::min(text.size(), window_start + 200))) {
+					std::cerr << "seed " << seed << ", edit " << i << ": ";
+					success = check(false, "the highlight after an edit differs from a new cache") && success;
+					break;
+				}
+			}
+		}
+	}
+	return success ? 0 : 1;
+}
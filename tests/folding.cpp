@@ -0,0 +1,112 @@
+#include <prism.hpp>
+#include <string>
+#include <random>
+#include <iostream>
+
+// counts the chunks that are requested, each one is 64 bytes
+class CountingInput final: public Input {
+	static constexpr std::size_t CHUNK_SIZE = 64;
+	const std::string& text;
+public:
+	mutable std::size_t chunks = 0;
+	CountingInput(const std::string& text): text(text) {}
+	std::pair<Chunk, std::size_t> get_chunk(std::size_t pos) const override {
+		const std::size_t offset = std::min(pos, text.size()) / CHUNK_SIZE * CHUNK_SIZE;
+		++chunks;
+		return {{reinterpret_cast<const void*>(offset), text.data() + offset, std::min(CHUNK_SIZE, text.size() - offset)}, offset};
+	}
+	Chunk get_next_chunk(const void* chunk) const override {
+		const std::size_t offset = reinterpret_cast<std::size_t>(chunk) + CHUNK_SIZE;
+		if (offset >= text.size()) {
+			return {nullptr, nullptr, 0};
+		}
+		++chunks;
+		return {reinterpret_cast<const void*>(offset), text.data() + offset, std::min(CHUNK_SIZE, text.size() - offset)};
+	}
+};
+
+static bool check(bool condition, const char* message) {
+	if (!condition) {
+		std::cerr << message << '\n';
+	}
+	return condition;
+}
+
+static bool operator ==(const FoldingRange& a, const FoldingRange& b) {
+	return a.start_line == b.start_line && a.end_line == b.end_line && a.comment == b.comment;
+}
+
+// the ranges are the same as with a new index
+static bool ranges_match(const std::string& text, const std::vector<FoldingRange>& ranges) {
+	const StringInput input(text.data(), text.size());
+	Cache cache;
+	FoldingIndex index;
+	return ranges == prism::folding_ranges(&prism::languages::c, &input, cache, index);
+}
+
+int main() {
+	bool success = true;
+	{
+		const std::string text = "// a\n// b\n\n// c\nint f() {\n\tg(1,\n\t\t2);\n}\n/* d\n*/ int x[] = {1};\n";
+		const StringInput input(text.data(), text.size());
+		Cache cache;
+		FoldingIndex index;
+		const std::vector<FoldingRange> expected = {{0, 1, true}, {4, 7, false}, {5, 6, false}, {8, 9, true}};
+		success = check(prism::folding_ranges(&prism::languages::c, &input, cache, index) == expected, "the ranges of the bracket pairs and comment blocks are wrong") && success;
+	}
+	{
+		// random edits, the cache is also used for other windows between the updates
+		const char* pieces[] = {"(", ")", "{", "}", "/*", "*/", "\"", "//", "\n", "\n\n", "// c\n", "f(x,\n y);", "if (a) {\n b();\n}"};
+		std::mt19937 random(1);
+		for (int seed = 0; seed < 60; ++seed) {
+			std::string text;
+			for (int i = 0; i < 20; ++i) {
+				text += "// comment\n// more\nint f(int a) {\n\t/* (a\n\t b) */ return g(a,\n\t\t\"{\");\n}\n\n";
+			}
+			Cache cache;
+			FoldingIndex index;
+			for (int i = 0; i < 30; ++i) {
+				const StringInput input(text.data(), text.size());
+				if (!ranges_match(text, prism::folding_ranges(&prism::languages::c, &input, cache, index))) {
+					std::cerr << "seed " << seed << ", edit " << i << ": ";
+					success = check(false, "the ranges after an edit differ from those of a new index") && success;
+					break;
+				}
+				if (random() % 2) {
+					const std::size_t window_start = random() % (text.size() + 1);
+					prism::highlight(&prism::languages::c, &input, cache, window_start, std::min(text.size(), window_start + 100));
+				}
+				const std::size_t pos = random() % (text.size() + 1);
+				const std::size_t deleted = std::min<std::size_t>(random() % 4, text.size() - pos);
+				const std::string inserted = random() % 2 ? pieces[random() % (sizeof(pieces) / sizeof(pieces[0]))] : "";
+				text.replace(pos, deleted, inserted);
+				const StringInput edited_input(text.data(), text.size());
+				cache.edit(&edited_input, pos, deleted, inserted.size());
+				index.edit(cache, pos, deleted, inserted.size());
+			}
+		}
+	}
+	{
+		// a new line near the start moves the ranges behind it without parsing the input behind it again
+		std::string text;
+		for (int i = 0; i < 10000; ++i) {
+			text += "// comment\n// more\nif (a) {\n\tf(b);\n}\n";
+		}
+		Cache cache;
+		FoldingIndex index;
+		{
+			const StringInput input(text.data(), text.size());
+			prism::folding_ranges(&prism::languages::c, &input, cache, index);
+		}
+		const std::size_t pos = text.find("f(b", 100);
+		text.insert(pos, "g();\n\t");
+		CountingInput input(text);
+		cache.edit(&input, pos, 0, 6);
+		index.edit(cache, pos, 0, 6);
+		input.chunks = 0;
+		const std::vector<FoldingRange> ranges = prism::folding_ranges(&prism::languages::c, &input, cache, index);
+		success = check(input.chunks < 1000, "the update after an edit parsed the input behind it") && success;
+		success = check(ranges_match(text, ranges), "the ranges after an edit near the start differ from those of a new index") && success;
+	}
+	return success ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include <prism.hpp>
+#include <string>
+#include <random>
+#include <iostream>
+
+static bool check(bool condition, const char* message) {
+	if (!condition) {
+		std::cerr << message << '\n';
+	}
+	return condition;
+}
+
+// the spans of a full highlight that fall into the window
+static std::vector<Span> slice(const std::vector<Span>& spans, std::size_t window_start, std::size_t window_end) {
+	std::vector<Span> result;
+	for (const Span& span: spans) {
+		const std::size_t start = std::max(span.start, window_start);
+		const std::size_t end = std::min(span.end, window_end);
+		if (start < end) {
+			result.emplace_back(start, end, span.style);
+		}
+	}
+	return result;
+}
+
+int main() {
+	bool success = true;
+	// short lines, a comment across lines and long lines like those of minified code
+	std::string text;
+	for (int i = 0; i < 10; ++i) {
+		text += "int f(int a) {\n\t/* a comment\n\t that ends here */ return g(a, \"b\", 0x1F);\n}\n";
+		for (int j = 0; j < 200; ++j) {
+			text += "x=f(\"s\",1/*c*/)+0x2A;";
+		}
+		text += "\n\n";
+	}
+	const StringInput input(text.data(), text.size());
+	std::vector<std::size_t> line_starts = {0};
+	for (std::size_t pos = 0; pos < text.size(); ++pos) {
+		if (text[pos] == '\n') {
+			line_starts.push_back(pos + 1);
+		}
+	}
+	Cache full_cache;
+	const std::vector<Span> spans = prism::highlight(&prism::languages::c, &input, full_cache, 0, text.size());
+	Cache cache;
+	std::mt19937 random(1);
+	for (int i = 0; i < 300; ++i) {
+		// scrolling through the lines and the columns of a long line, with windows past the end of the lines and the input
+		const std::size_t first_line = random() % (line_starts.size() + 2);
+		const std::size_t count = random() % 6;
+		const std::size_t first_column = random() % 2 ? random() % 20 : random() % 5000;
+		const std::size_t last_column = first_column + random() % 200;
+		const Lines lines = prism::highlight_lines(&prism::languages::c, &input, cache, first_line, count, first_column, last_column);
+		const std::size_t expected_size = first_line >= line_starts.size() ? 0 : std::min(count, line_starts.size() - first_line);
+		bool lines_match = lines.size() == expected_size;
+		for (std::size_t j = 0; lines_match && j < lines.size(); ++j) {
+			const std::size_t line_start = line_starts[first_line + j];
+			const std::size_t line_end = first_line + j + 1 < line_starts.size() ? line_starts[first_line + j + 1] : text.size();
+			const std::size_t window_start = line_start + std::min(first_column, line_end - line_start);
+			const std::size_t window_end = line_start + std::min(last_column, line_end - line_start);
+			const Lines::Line line = lines[j];
+			const std::vector<Span> expected = slice(spans, window_start, window_end);
+			lines_match = line.range.start == window_start && line.range.end == window_end && static_cast<std::size_t>(line.end() - line.begin()) == expected.size();
+			for (std::size_t k = 0; lines_match && k < expected.size(); ++k) {
+				const Span& span = line.begin()[k];
+				lines_match = span.start == expected[k].start && span.end == expected[k].end && span.style == expected[k].style;
+			}
+		}
+		if (!lines_match) {
+			std::cerr << "lines " << first_line << " to " << first_line + count << ", columns " << first_column << " to " << last_column << ": ";
+			success = check(false, "the columns of the lines differ from a slice of a highlight of the whole input") && success;
+			break;
+		}
+	}
+	return success ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#include <grammar.hpp>
+#include <languages/c.hpp>
+#include <string>
+#include <iostream>
+
+// a comment that needs its closing delimiter, so it can not add checkpoints and a window has to look for the end
+struct strict_comment_language {
+	static constexpr auto expression = choice(
+		highlight(Style::COMMENT, sequence("/*", repetition(any_char_but("*/")), "*/")),
+		highlight(Style::KEYWORD, c_keywords("if", "while"))
+	);
+};
+static constexpr Language strict_comment = language<FileType, strict_comment_language>("strict comment");
+
+// small chunks, the furthest chunk that was requested shows how far parsing read
+class TrackingInput final: public Input {
+	static constexpr std::size_t CHUNK_SIZE = 64;
+	const std::string& text;
+public:
+	mutable std::size_t max_offset = 0;
+	mutable std::size_t chunks = 0;
+	TrackingInput(const std::string& text): text(text) {}
+	std::pair<Chunk, std::size_t> get_chunk(std::size_t pos) const override {
+		const std::size_t offset = std::min(pos, text.size()) / CHUNK_SIZE * CHUNK_SIZE;
+		max_offset = std::max(max_offset, offset);
+		++chunks;
+		return {{reinterpret_cast<const void*>(offset), text.data() + offset, std::min(CHUNK_SIZE, text.size() - offset)}, offset};
+	}
+	Chunk get_next_chunk(const void* chunk) const override {
+		const std::size_t offset = reinterpret_cast<std::size_t>(chunk) + CHUNK_SIZE;
+		if (offset >= text.size()) {
+			return {nullptr, nullptr, 0};
+		}
+		max_offset = std::max(max_offset, offset);
+		++chunks;
+		return {reinterpret_cast<const void*>(offset), text.data() + offset, std::min(CHUNK_SIZE, text.size() - offset)};
+	}
+};
+
+static bool check(bool condition, const char* message) {
+	if (!condition) {
+		std::cerr << message << '\n';
+	}
+	return condition;
+}
+
+int main() {
+	bool success = true;
+	Budget budget;
+	budget.overshoot = 100;
+	{
+		// an unterminated comment
+		const std::string text = "if /*" + std::string(200000, 'a');
+		TrackingInput input(text);
+		Cache cache;
+		prism::highlight(&strict_comment, &input, cache, 0, 100, budget);
+		success = check(input.max_offset < 100 + 100 + 64, "the first window read past the overshoot") && success;
+		input.max_offset = 0;
+		prism::highlight(&strict_comment, &input, cache, 50000, 50100, budget);
+		success = check(input.max_offset < 50100 + 100 + 64, "a later window read past the overshoot") && success;
+		// an unbounded highlight of the same cache sees the real end of the input
+		Cache fresh;
+		success = check(prism::highlight(&strict_comment, &input, cache, 0, text.size()) == prism::highlight(&strict_comment, &input, fresh, 0, text.size()), "the unbounded highlight differs after bounded ones") && success;
+	}
+	{
+		// a comment that is closed far after the windows that are highlighted with a bound
+		const std::string text = "if /*" + std::string(200000, 'a') + "*/ while";
+		TrackingInput input(text);
+		Cache cache;
+		std::size_t worst = 0;
+		for (std::size_t window_start = 0; window_start < text.size(); window_start += 4096) {
+			input.max_offset = 0;
+			prism::highlight(&strict_comment, &input, cache, window_start, std::min(text.size(), window_start + 4096), budget);
+			worst = std::max(worst, input.max_offset - std::min(input.max_offset, window_start));
+		}
+		success = check(worst < 4096 + 100 + 64, "a window read past the overshoot") && success;
+		// the checkpoints that relied on the shortened input were dropped, so later windows resume correctly
+		Cache fresh;
+		success = check(prism::highlight(&strict_comment, &input, cache, 100000, text.size()) == prism::highlight(&strict_comment, &input, fresh, 100000, text.size()), "a later window resumed from a wrong checkpoint") && success;
+	}
+	{
+		// with an overshoot that is large enough the spans and checkpoints are those of an unbounded highlight
+		const std::string text = "if /*" + std::string(20000, 'a') + "*/ while";
+		TrackingInput input(text);
+		Cache bounded, unbounded;
+		Budget large;
+		large.overshoot = 100000;
+		const HighlightResult result = prism::highlight(&strict_comment, &input, bounded, 0, 100, large);
+		const std::vector<Span> expected = prism::highlight(&strict_comment, &input, unbounded, 0, 100);
+		success = check(std::vector<Span>(result.spans.begin(), result.spans.end()) == expected && bounded.get_size() == unbounded.get_size(), "a large overshoot changed the result") && success;
+	}
+	{
+		// a bounded highlight keeps the checkpoints of an earlier unbounded highlight past its end
+		std::string code;
+		for (int i = 0; i < 10000; ++i) {
+			code += "if x while y\n";
+		}
+		// the first window ends in short tokens or in a comment that reaches past the overshoot
+		for (const std::string& text: {code, "if /*" + std::string(20000, 'a') + "*/\n" + code}) {
+			TrackingInput input(text);
+			Cache cache, fresh;
+			prism::highlight(&strict_comment, &input, cache, 0, text.size());
+			Budget small;
+			small.overshoot = 4096;
+			prism::highlight(&strict_comment, &input, cache, 0, 1000, small);
+			input.chunks = 0;
+			const std::vector<Span> spans = prism::highlight(&strict_comment, &input, cache, text.size() - 1000, text.size());
+			success = check(input.chunks < 100, "a bounded highlight dropped the checkpoints past its end") && success;
+			success = check(spans == prism::highlight(&strict_comment, &input, fresh, text.size() - 1000, text.size()), "the spans after a bounded highlight differ") && success;
+		}
+	}
+	{
+		// C code with short tokens highlights the same in bounded windows
+		std::string text;
+		for (int i = 0; i < 3000; ++i) {
+			text += "int f(int x) { /* comment */ return \"s\\n\" + 0x1F; } // line\n";
+		}
+		TrackingInput input(text);
+		Cache full_cache, cache;
+		const std::vector<Span> expected = prism::highlight(&prism::languages::c, &input, full_cache, 0, text.size());
+		std::vector<Span> spans;
+		Budget small;
+		small.overshoot = 200;
+		for (std::size_t window_start = 0; window_start < text.size(); window_start += 1000) {
+			for (const Span& span: prism::highlight(&prism::languages::c, &input, cache, window_start, std::min(text.size(), window_start + 1000), small).spans) {
+				if (!spans.empty() && spans.back().end == span.start && spans.back().style == span.style) {
+					spans.back().end = span.end;
+				}
+				else {
+					spans.push_back(span);
+				}
+			}
+		}
+		success = check(spans == expected, "the bounded windows of C differ from the full highlight") && success;
+	}
+	return success ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+#include <prism.hpp>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+
+// code followed by a token that runs to the end of an input of size bytes, only the code is stored
+// records how far the input was read, also from the background thread
+class TokenInput final: public Input {
+	static constexpr std::size_t CHUNK_SIZE = 4096;
+	std::string code;
+	std::string filler;
+	std::size_t size;
+	Chunk make_chunk(std::size_t offset) const {
+		const std::size_t chunk_size = std::min(CHUNK_SIZE, size - offset);
+		const char* data = offset < code.size() ? code.data() + offset : filler.data();
+		std::size_t chunk_end = offset + chunk_size;
+		std::size_t read_end = max_end.load();
+		while (read_end < chunk_end && !max_end.compare_exchange_weak(read_end, chunk_end)) {}
+		++chunks;
+		return {reinterpret_cast<const void*>(offset), data, chunk_size};
+	}
+public:
+	mutable std::atomic<std::size_t> chunks{0};
+	mutable std::atomic<std::size_t> max_end{0};
+	// the line is repeated up to code_size bytes, followed by the start of the token and the filler up to size
+	// code_size is a multiple of the chunk size
+	TokenInput(const char* line, std::size_t code_size, const char* token, char filler, std::size_t size): filler(CHUNK_SIZE, filler), size(size) {
+		const std::string token_start(token);
+		while (code.size() < code_size) {
+			code += line;
+		}
+		code.resize(code_size - token_start.size(), '\n');
+		code += token_start;
+	}
+	std::pair<Chunk, std::size_t> get_chunk(std::size_t pos) const override {
+		const std::size_t offset = std::min(pos, size) / CHUNK_SIZE * CHUNK_SIZE;
+		return {make_chunk(offset), offset};
+	}
+	Chunk get_next_chunk(const void* chunk) const override {
+		const std::size_t offset = reinterpret_cast<std::size_t>(chunk) + CHUNK_SIZE;
+		if (offset >= size) {
+			return {nullptr, nullptr, 0};
+		}
+		return make_chunk(offset);
+	}
+};
+
+static bool check(bool condition, const char* message) {
+	if (!condition) {
+		std::cerr << message << '\n';
+	}
+	return condition;
+}
+
+static bool spans_match(const Input* input, const std::vector<Span>& spans, std::size_t window_start, std::size_t window_end) {
+	Cache cache;
+	const std::vector<Span> expected = prism::highlight(&prism::languages::c, input, cache, window_start, window_end);
+	if (spans.size() != expected.size()) {
+		return false;
+	}
+	for (std::size_t i = 0; i < spans.size(); ++i) {
+		if (spans[i].start != expected[i].start || spans[i].end != expected[i].end || spans[i].style != expected[i].style) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// waits until the input was read up to pos, returns false after 10 seconds
+static bool wait_for_read(const TokenInput& input, std::size_t pos) {
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (input.max_end.load() < pos) {
+		if (std::chrono::steady_clock::now() >= deadline) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+static double get_milliseconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+	bool success = true;
+	constexpr std::size_t DISTANCE = 1024 * 1024;
+	{
+		// the background thread builds the checkpoints ahead of the window that the next highlight continues from
+		const TokenInput input("int f(int a) { return g(a, \"b\"); } // c\n", 2 * DISTANCE, "/*", 'x', 2 * DISTANCE + 4096);
+		Cache cache;
+		Prefetcher prefetcher(DISTANCE);
+		const std::vector<Span> spans = prefetcher.highlight(&prism::languages::c, &input, cache, 0, 100);
+		success = check(spans_match(&input, spans, 0, 100), "the spans of the prefetcher differ from those of a highlight") && success;
+		success = check(wait_for_read(input, 100 + DISTANCE), "the prefetching did not reach the distance") && success;
+		prefetcher.stop();
+		// the input is read up to one chunk past the chunk that contains the end of the distance
+		success = check(input.max_end.load() <= 100 + DISTANCE + 2 * 4096, "the prefetching read past the distance") && success;
+		input.chunks = 0;
+		const std::vector<Span> next_spans = prism::highlight(&prism::languages::c, &input, cache, 100 + DISTANCE - 100, 100 + DISTANCE);
+		success = check(input.chunks < 4, "the highlight after the prefetching parsed the input again") && success;
+		success = check(spans_match(&input, next_spans, 100 + DISTANCE - 100, 100 + DISTANCE), "the spans after the prefetching differ from those of a highlight") && success;
+	}
+	{
+		// the prefetching only sees the interrupt at checkpoints, there are none in the whitespace of a preprocessor directive
+		// that runs to the end of a huge input, a highlight still interrupts it
+		const TokenInput input("int a;\n", 4096, "#", ' ', static_cast<std::size_t>(1) << 40);
+		Cache cache;
+		Prefetcher prefetcher(DISTANCE);
+		prefetcher.highlight(&prism::languages::c, &input, cache, 0, 100);
+		success = check(wait_for_read(input, DISTANCE / 4), "the prefetching did not reach the directive") && success;
+		const auto start = std::chrono::steady_clock::now();
+		const std::vector<Span> spans = prefetcher.highlight(&prism::languages::c, &input, cache, 0, 100);
+		success = check(get_milliseconds(start) < 2000, "the highlight waited for the prefetching of the directive") && success;
+		success = check(input.max_end.load() <= 100 + DISTANCE + 2 * 4096, "the prefetching of the directive read past the distance") && success;
+		success = check(spans_match(&input, spans, 0, 100), "the spans of the interrupting highlight are wrong") && success;
+	}
+	{
+		// after stop returns, the background thread does not read the input anymore
+		const TokenInput input("int a;\n", 4096, "#", ' ', static_cast<std::size_t>(1) << 40);
+		Cache cache;
+		Prefetcher prefetcher(DISTANCE);
+		prefetcher.highlight(&prism::languages::c, &input, cache, 0, 100);
+		success = check(wait_for_read(input, DISTANCE / 4), "the prefetching did not reach the directive") && success;
+		const auto start = std::chrono::steady_clock::now();
+		prefetcher.stop();
+		success = check(get_milliseconds(start) < 2000, "stop waited for the prefetching of the directive") && success;
+		const std::size_t chunks = input.chunks;
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		success = check(input.chunks == chunks, "the input was read after stop") && success;
+	}
+	return success ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#include <prism.hpp>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+
+static bool check(bool condition, const char* message) {
+	if (!condition) {
+		std::cerr << message << '\n';
+	}
+	return condition;
+}
+
+int main() {
+	bool success = true;
+	{
+		// the spans arrive in order with batches of any size and a queue that is mostly full or empty
+		constexpr std::size_t COUNT = 200000;
+		SpanQueue queue(16);
+		std::thread producer([&]() {
+			std::mt19937 random(1);
+			std::vector<Span> spans;
+			for (std::size_t i = 0; i < COUNT;) {
+				spans.clear();
+				const std::size_t size = std::min<std::size_t>(random() % 40 + 1, COUNT - i);
+				for (std::size_t j = 0; j < size; ++j, ++i) {
+					spans.emplace_back(i, i + 1, static_cast<int>(i % 16));
+				}
+				queue.add_spans(spans.data(), spans.size());
+			}
+			queue.close();
+		});
+		std::mt19937 random(2);
+		Span spans[40];
+		std::size_t next = 0;
+		bool ordered = true;
+		while (const std::size_t size = queue.get_spans(spans, random() % 40 + 1)) {
+			for (std::size_t i = 0; i < size; ++i, ++next) {
+				ordered = ordered && spans[i].start == next && spans[i].end == next + 1 && spans[i].style == static_cast<int>(next % 16);
+			}
+		}
+		producer.join();
+		success = check(ordered, "the spans arrived out of order") && success;
+		success = check(next == COUNT, "not all spans arrived before the queue reported that it is closed") && success;
+		success = check(queue.get_spans(spans, 40) == 0, "a closed and empty queue returned spans") && success;
+	}
+	{
+		// a consumer that waits for spans does not keep a core busy and returns once the queue is closed
+		SpanQueue queue;
+		std::size_t size = -1;
+		const std::clock_t cpu_start = std::clock();
+		std::thread consumer([&]() {
+			Span span;
+			size = queue.get_spans(&span, 1);
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		const double cpu_seconds = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+		queue.close();
+		consumer.join();
+		success = check(cpu_seconds < 0.1, "the consumer kept spinning while the queue was empty") && success;
+		success = check(size == 0, "closing an empty queue did not end the wait of the consumer") && success;
+	}
+	{
+		// a producer that waits for space is woken up by the consumer
+		SpanQueue queue(4);
+		const Span spans[8] = {{0, 1, 1}, {1, 2, 2}, {2, 3, 3}, {3, 4, 4}, {4, 5, 5}, {5, 6, 6}, {6, 7, 7}, {7, 8, 8}};
+		std::thread producer([&]() {
+			queue.add_spans(spans, 8);
+			queue.close();
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		Span received[8];
+		std::size_t size = 0;
+		while (const std::size_t count = queue.get_spans(received + size, 8 - size)) {
+			size += count;
+		}
+		producer.join();
+		success = check(size == 8 && received[7].start == 7 && received[7].style == 8, "the producer did not finish after the consumer made space") && success;
+	}
+	return success ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+#include <prism.hpp>
+#include <string>
+#include <random>
+#include <iostream>
+
+static bool check(bool condition, const char* message) {
+	if (!condition) {
+		std::cerr << message << '\n';
+	}
+	return condition;
+}
+
+int main() {
+	bool success = true;
+	{
+		// columns count UTF-16 code units, é is one and 😀 is two, a span that crosses a line end is one token per line
+		const std::string text = "ab\n\xC3\xA9\xF0\x9F\x98\x80x\ncd";
+		const StringInput input(text.data(), text.size());
+		const std::vector<Span> spans = {{0, 2, Style::COMMENT}, {5, 9, Style::STRING}, {9, 12, Style::KEYWORD}};
+		SemanticTokens tokens;
+		const std::uint32_t string_type = Style::STRING - Style::COMMENT;
+		const std::uint32_t keyword_type = Style::KEYWORD - Style::COMMENT;
+		const std::vector<std::uint32_t> expected = {
+			0, 0, 2, 0, 0,
+			1, 1, 2, string_type, 0,
+			0, 2, 1, keyword_type, 0,
+			1, 0, 1, keyword_type, 0
+		};
+		success = check(tokens.full(&input, spans) == expected, "the semantic tokens are encoded wrongly") && success;
+	}
+	{
+		// applying the edits of a delta to the previous result gives the full result
+		const char* pieces[] = {"/*", "*/", "\"", "//", "\n", "\xC3\xA9", "\xF0\x9F\x98\x80", "int ", "0x1F", "f(a);"};
+		std::mt19937 random(1);
+		for (int seed = 0; seed < 40; ++seed) {
+			std::string text;
+			for (int i = 0; i < 10; ++i) {
+				text += "int f(int a) {\n\t/* \xC3\xA9 */ return g(a, \"\xF0\x9F\x98\x80\", 0x1F);\n}\n";
+			}
+			Cache cache;
+			SemanticTokens tokens;
+			{
+				const StringInput input(text.data(), text.size());
+				tokens.full(&input, prism::highlight(&prism::languages::c, &input, cache, 0, text.size()));
+			}
+			for (int i = 0; i < 20; ++i) {
+				const std::size_t pos = random() % (text.size() + 1);
+				const std::size_t deleted = std::min<std::size_t>(random() % 4, text.size() - pos);
+				const std::string inserted = random() % 2 ? pieces[random() % (sizeof(pieces) / sizeof(pieces[0]))] : "";
+				text.replace(pos, deleted, inserted);
+				const StringInput input(text.data(), text.size());
+				cache.edit(&input, pos, deleted, inserted.size());
+				const std::vector<Span> spans = prism::highlight(&prism::languages::c, &input, cache, 0, text.size());
+				std::vector<std::uint32_t> data = tokens.get_data();
+				const std::uint64_t result_id = tokens.get_result_id();
+				const std::vector<SemanticTokens::Edit> edits = tokens.delta(&input, spans);
+				// the edits refer to the previous result, applying them back to front keeps their starts valid
+				for (auto edit = edits.rbegin(); edit != edits.rend(); ++edit) {
+					data.erase(data.begin() + edit->start, data.begin() + edit->start + edit->delete_count);
+					data.insert(data.begin() + edit->start, edit->data.begin(), edit->data.end());
+				}
+				SemanticTokens full_tokens;
+				if (data != full_tokens.full(&input, spans) || data != tokens.get_data() || tokens.get_result_id() != result_id + 1) {
+					std::cerr << "seed " << seed << ", edit " << i << ": ";
+					success = check(false, "the edits of a delta do not turn the previous result into the full result") && success;
+					break;
+				}
+			}
+		}
+	}
+	return success ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#include <prism.hpp>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+static bool check(bool condition, const char* message) {
+	if (!condition) {
+		std::cerr << message << '\n';
+	}
+	return condition;
+}
+
+class VectorSink final: public SpanSink {
+public:
+	std::vector<Span> spans;
+	void add_spans(const Span* spans, std::size_t size) override {
+		this->spans.insert(this->spans.end(), spans, spans + size);
+	}
+};
+
+static bool spans_equal(const std::vector<Span>& a, const std::vector<Span>& b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		if (a[i].start != b[i].start || a[i].end != b[i].end || a[i].style != b[i].style) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	if (argc != 2) {
+		std::cerr << "Usage: " << argv[0] << " DIRECTORY\n";
+		return 1;
+	}
+	bool success = true;
+	for (const char* file_name: {"test.c", "test.hs", "test.java", "test.js", "test.py", "test.rs"}) {
+		std::ifstream file(std::string(argv[1]) + '/' + file_name);
+		std::stringstream content;
+		content << file.rdbuf();
+		const std::string text = content.str();
+		const StringInput input(text.data(), text.size());
+		const Language* language = prism::get_language(file_name);
+		if (!file || language == nullptr) {
+			std::cerr << file_name << ": could not be read or has no language\n";
+			success = false;
+			continue;
+		}
+		Cache full_cache;
+		const std::vector<Span> expected = prism::highlight(language, &input, full_cache, 0, text.size());
+		// windows that end inside of tokens and sparse checkpoints that are pruned right away
+		for (std::size_t window_size: {1, 7, 64, 1000, 64 * 1024}) {
+			Cache cache;
+			VectorSink sink;
+			prism::highlight_stream(language, &input, cache, sink, window_size, 100);
+			if (!spans_equal(sink.spans, expected)) {
+				std::cerr << file_name << ", windows of " << window_size << " bytes: ";
+				success = check(false, "the streamed spans differ from the spans of a highlight of the whole input") && success;
+			}
+		}
+	}
+	{
+		// the cache stays small for a large input and can still be used for a window in the middle
+		std::string text;
+		while (text.size() < 1024 * 1024) {
+			text += "int f(int a) {\n\t/* comment */ return g(a, \"b\", 0x1F);\n}\n";
+		}
+		const StringInput input(text.data(), text.size());
+		Cache cache;
+		VectorSink sink;
+		prism::highlight_stream(&prism::languages::c, &input, cache, sink, 16 * 1024, 128 * 1024);
+		Cache full_cache;
+		const std::vector<Span> expected = prism::highlight(&prism::languages::c, &input, full_cache, 0, text.size());
+		success = check(spans_equal(sink.spans, expected), "the streamed spans of a large input differ from the spans of a highlight of the whole input") && success;
+		success = check(cache.get_size() * 20 < full_cache.get_size(), "the cache of the stream kept more than its sparse checkpoints") && success;
+		const std::size_t window_start = text.size() / 2;
+		Cache new_cache;
+		success = check(spans_equal(prism::highlight(&prism::languages::c, &input, cache, window_start, window_start + 100), prism::highlight(&prism::languages::c, &input, new_cache, window_start, window_start + 100)), "the cache of the stream gives wrong spans for a window in the middle") && success;
+	}
+	return success ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+# runs prism-terminal on standard input
+# cmake -DPRISM_TERMINAL=<path of prism-terminal> -DOUTPUT_DIRECTORY=<directory> -P terminal.cmake
+
+function(run_terminal name input expected_result)
+	file(WRITE ${OUTPUT_DIRECTORY}/${name}.in "${input}")
+	execute_process(
+		COMMAND ${PRISM_TERMINAL} --color=none ${ARGN} -
+		INPUT_FILE ${OUTPUT_DIRECTORY}/${name}.in
+		OUTPUT_FILE ${OUTPUT_DIRECTORY}/${name}.out
+		ERROR_QUIET
+		RESULT_VARIABLE result
+	)
+	if(NOT result EQUAL expected_result)
+		message(FATAL_ERROR "${name}: prism-terminal returned ${result}")
+	endif()
+	if(result EQUAL 0)
+		# without colors the input is printed between two newlines
+		file(READ ${OUTPUT_DIRECTORY}/${name}.out output)
+		if(NOT output STREQUAL "\n${input}\n")
+			message(FATAL_ERROR "${name}: the output differs from the input")
+		endif()
+	endif()
+endfunction()
+
+# an unterminated comment of about 1 MB is printed in chunks without parsing it again for every line
+set(comment "line of the comment\n")
+foreach(i RANGE 15)
+	string(APPEND comment "${comment}")
+endforeach()
+run_terminal(unterminated-comment "int x;\n/* start\n${comment}" 0 --language=c)
+
+# the language is detected once a line that is not blank arrives
+run_terminal(detect-json "\n{\"a\": 1}\n" 0)
+run_terminal(detect-python "#!/usr/bin/env python\nx = 1\n" 0)
+run_terminal(undetected "int x;\n" 1)
+
+# an unknown color mode is an error instead of turning the colors off
+run_terminal(unknown-color "int x;\n" 1 --language=c --color=bright)
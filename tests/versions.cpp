@@ -0,0 +1,83 @@
+#include <grammar.hpp>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cinttypes>
+#include <cstdio>
+
+// the spans of the sample files as of the version of their language
+// a grammar change that changes the spans of a sample has to increase the version of its language in languages/*.cpp,
+// otherwise SpanStore would keep returning the spans of the old grammar, and then update the entry to what this test prints
+struct Sample {
+	const char* file_name;
+	unsigned version;
+	std::uint64_t hash;
+};
+constexpr Sample samples[] = {
+	{"test.c", 1, 0xde3f46f53a4d3b1c},
+	{"test.hs", 1, 0xda918d6d9a109bed},
+	{"test.java", 1, 0xb2ef4afd8da74b0d},
+	{"test.js", 1, 0xa2d1231d21546787},
+	{"test.json", 1, 0x8d94b558aacab03b},
+	{"test.py", 1, 0x934b4bf19f553285},
+	{"test.rs", 1, 0x97bd651e58c239b4},
+	{"test.toml", 1, 0x4ecc973a98a8c633},
+	{"test.xml", 1, 0x1078c0e4eafe317a},
+};
+
+// a 64 bit FNV-1a hash of the encoded spans
+static std::uint64_t hash_spans(const std::vector<Span>& spans) {
+	std::uint64_t hash = 14695981039346656037u;
+	for (char c: prism::encode_spans(spans)) {
+		hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211u;
+	}
+	return hash;
+}
+
+int main(int argc, char** argv) {
+	if (argc != 2) {
+		std::cerr << "Usage: " << argv[0] << " DIRECTORY\n";
+		return 1;
+	}
+	bool success = true;
+	for (const Sample& sample: samples) {
+		std::ifstream file(std::string(argv[1]) + '/' + sample.file_name);
+		std::stringstream content;
+		content << file.rdbuf();
+		const std::string text = content.str();
+		const StringInput input(text.data(), text.size());
+		const Language* language = prism::get_language(sample.file_name);
+		if (!file || language == nullptr) {
+			std::cerr << sample.file_name << ": could not be read or has no language\n";
+			success = false;
+			continue;
+		}
+		Cache cache;
+		const std::vector<Span> spans = prism::highlight(language, &input, cache, 0, text.size());
+		const std::uint64_t hash = hash_spans(spans);
+		if (language->version != sample.version || hash != sample.hash) {
+			char entry[64];
+			std::snprintf(entry, sizeof(entry), "%u, 0x%016" PRIx64, language->version, hash);
+			std::cerr << sample.file_name << ": the spans changed, increase the version of " << language->name << " if it has not been increased yet and update the entry to {\"" << sample.file_name << "\", " << entry << "}\n";
+			success = false;
+		}
+		// the stored spans are read back for an input of the same size, but not for a shorter one
+		const std::string data = prism::encode_spans(spans);
+		std::vector<Span> decoded_spans;
+		if (!prism::decode_spans(StringView(data.data(), data.size()), decoded_spans, text.size()) || prism::encode_spans(decoded_spans) != data || (!spans.empty() && prism::decode_spans(StringView(data.data(), data.size()), decoded_spans, spans.back().end - 1))) {
+			std::cerr << sample.file_name << ": the encoded spans are not decoded correctly\n";
+			success = false;
+		}
+	}
+	{
+		// a length that wraps the end of the second span around to before its start is not a valid encoding
+		const std::string data = "\x13\x04\x03\xFE\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x01";
+		std::vector<Span> decoded_spans;
+		if (prism::decode_spans(StringView(data.data(), data.size()), decoded_spans)) {
+			std::cerr << "a span that wraps around was decoded\n";
+			success = false;
+		}
+	}
+	return success ? 0 : 1;
+}